@@ -0,0 +1,141 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Cost of load_config() for a folder of many scripts, in two layouts:
+ *   greedy - no devilspie2.lua; every script is run on window open
+ *   listed - devilspie2.lua names every script for window open, some for
+ *            window close too, and gives match declarations for some
+ * Prints one JSON object per line.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include "config.h"
+
+#define SCRIPTS 1000
+#define RUNS 50
+
+static const char rule[] =
+	"if get_window_name() == 'Terminal' then\n"
+	"	set_window_workspace(2)\n"
+	"end\n";
+
+
+static void write_file(const gchar *folder, const gchar *name, const gchar *contents)
+{
+	gchar *path = g_build_filename(folder, name, NULL);
+
+	if (!g_file_set_contents(path, contents, -1, NULL)) {
+		fprintf(stderr, "couldn't write %s\n", path);
+		exit(1);
+	}
+	g_free(path);
+}
+
+
+static gchar *make_folder(gboolean listed)
+{
+	gchar *folder = g_dir_make_tmp("devilspie2-bench-XXXXXX", NULL);
+	GString *config = g_string_new("scripts_window_open = {\n");
+	int i;
+
+	if (!folder) {
+		fprintf(stderr, "couldn't create a temporary folder\n");
+		exit(1);
+	}
+
+	// created in reverse order, so that nothing is sorted already
+	for (i = SCRIPTS - 1; i >= 0; i--) {
+		gchar *name = g_strdup_printf("script-%04d.lua", i);
+		write_file(folder, name, rule);
+		g_string_append_printf(config, "\t\"%s\",\n", name);
+		g_free(name);
+	}
+
+	g_string_append(config, "}\nscripts_window_close = {\n");
+	for (i = 0; i < SCRIPTS; i += 10)
+		g_string_append_printf(config, "\t\"script-%04d.lua\",\n", i);
+
+	g_string_append(config, "}\nscript_match = {\n");
+	for (i = 0; i < SCRIPTS; i += 4)
+		g_string_append_printf(config, "\t[\"script-%04d.lua\"] = { class = \"Class%d\" },\n", i, i % 50);
+	g_string_append(config, "}\n");
+
+	if (listed)
+		write_file(folder, "devilspie2.lua", config->str);
+
+	g_string_free(config, TRUE);
+	return folder;
+}
+
+
+static void remove_folder(gchar *folder)
+{
+	GDir *dir = g_dir_open(folder, 0, NULL);
+	const gchar *name;
+
+	while (dir && (name = g_dir_read_name(dir))) {
+		gchar *path = g_build_filename(folder, name, NULL);
+		g_unlink(path);
+		g_free(path);
+	}
+	if (dir)
+		g_dir_close(dir);
+	g_rmdir(folder);
+	g_free(folder);
+}
+
+
+static void run(const char *mode, gboolean listed)
+{
+	gchar *folder = make_folder(listed);
+	gchar *config_filename = g_build_filename(folder, "devilspie2.lua", NULL);
+	guint count = 0;
+	gint64 start;
+	int i;
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < RUNS; i++) {
+		if (load_config(config_filename) != 0) {
+			fprintf(stderr, "couldn't load %s\n", config_filename);
+			exit(1);
+		}
+		get_scripts(&count);
+		clear_file_lists();
+	}
+
+	printf("{\"bench\":\"load_config\",\"mode\":\"%s\",\"files\":%d,\"scripts\":%u,\"ms_per_load\":%.3f}\n",
+	       mode, SCRIPTS, count, (g_get_monotonic_time() - start) / 1000.0 / RUNS);
+
+	g_free(config_filename);
+	remove_folder(folder);
+}
+
+
+int main(void)
+{
+	run("greedy", FALSE);
+	run("listed", TRUE);
+	return 0;
+}
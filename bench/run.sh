@@ -0,0 +1,92 @@
+#!/bin/sh
+#
+# This file is part of devilspie2
+# Copyright (C) 2026 devilspie2 developers
+#
+# devilspie2 is free software: you can redistribute it and/or
+# modify it under the terms of the GNU General Public License as published
+# by the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# devilspie2 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with devilspie2.
+# If not, see <http://www.gnu.org/licenses/>.
+#
+
+# End-to-end dispatch benchmark: runs devilspie2 under Xvfb against rule sets
+# of various sizes and prints one JSON object per rule set.
+#
+# Environment:
+#   DEVILSPIE2     the binary to test (default: bin/devilspie2)
+#   BENCH_WINDOWS  the helper (default: bin/bench-windows)
+#   SIZES          rule-set sizes (default: "1 50 500")
+#   WINDOWS        windows mapped per rule set (default: 200)
+#   BENCH_DISPLAY  display for Xvfb (default: :99)
+
+set -e
+
+DEVILSPIE2=${DEVILSPIE2:-bin/devilspie2}
+BENCH_WINDOWS=${BENCH_WINDOWS:-bin/bench-windows}
+SIZES=${SIZES:-1 50 500}
+WINDOWS=${WINDOWS:-200}
+BENCH_DISPLAY=${BENCH_DISPLAY:-:99}
+
+if ! command -v Xvfb >/dev/null; then
+	echo 'bench: Xvfb not found' >&2
+	exit 1
+fi
+
+WORKDIR=$(mktemp -d)
+XVFB_PID=
+
+cleanup() {
+	test -z "$XVFB_PID" || kill "$XVFB_PID" 2>/dev/null || :
+	rm -rf -- "$WORKDIR"
+}
+trap cleanup EXIT INT TERM
+
+Xvfb "$BENCH_DISPLAY" -screen 0 1280x1024x24 -nolisten tcp >/dev/null 2>&1 &
+XVFB_PID=$!
+DISPLAY=$BENCH_DISPLAY
+export DISPLAY
+
+# wait for the server to come up
+i=0
+until xdpyinfo >/dev/null 2>&1 || test -S "/tmp/.X11-unix/X${BENCH_DISPLAY#:}"; do
+	i=$((i + 1))
+	if test $i -gt 50; then
+		echo 'bench: Xvfb did not start' >&2
+		exit 1
+	fi
+	sleep 0.1
+done
+
+# keep the daemon's cache etc. out of the user's home
+XDG_CACHE_HOME=$WORKDIR/cache
+XDG_CONFIG_HOME=$WORKDIR/config
+XDG_RUNTIME_DIR=$WORKDIR
+export XDG_CACHE_HOME XDG_CONFIG_HOME XDG_RUNTIME_DIR
+
+for size in $SIZES; do
+	rules=$WORKDIR/rules-$size
+	mkdir -p "$rules"
+
+	# one rule per window class; each window matches exactly one of them
+	n=1
+	while test $n -le "$size"; do
+		cat >"$rules/rule$n.lua" <<LUA
+if get_window_class() == "Bench$n" then
+	set_window_property("_DP2_BENCH", get_window_name())
+end
+LUA
+		n=$((n + 1))
+	done
+
+	"$BENCH_WINDOWS" -w "$WINDOWS" -c "$size" -l "scripts=$size" -- \
+		"$DEVILSPIE2" --folder "$rules"
+done
@@ -0,0 +1,159 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Start-up cost of compiling a folder of scripts (what preload_scripts()
+ * does), in three modes:
+ *   source  - no on-disk cache (the default)
+ *   rebuild - --rebuild-cache: compiled from source, cache files written
+ *   cached  - --cache with the cache files present
+ * Prints one JSON object per line.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <lua.h>
+#include <lauxlib.h>
+
+#include "script_cache.h"
+
+#define SCRIPTS 500
+#define RUNS 10
+
+
+static void write_file(const gchar *folder, const gchar *name, const gchar *contents)
+{
+	gchar *path = g_build_filename(folder, name, NULL);
+
+	if (!g_file_set_contents(path, contents, -1, NULL)) {
+		fprintf(stderr, "couldn't write %s\n", path);
+		exit(1);
+	}
+	g_free(path);
+}
+
+
+/**
+ * A script of a more or less realistic size: a few dozen rules.
+ */
+static gchar *make_script(int index)
+{
+	GString *script = g_string_new(NULL);
+	int i;
+
+	for (i = 0; i < 40; i++)
+		g_string_append_printf(script,
+		                       "if get_window_class() == \"Class%d_%d\" and get_window_name():find(\"title %d\") then\n"
+		                       "	set_window_geometry(%d, %d, 640, 480)\n"
+		                       "	set_window_workspace(%d)\n"
+		                       "end\n",
+		                       index, i, i, i * 10, i * 5, i % 4 + 1);
+
+	return g_string_free(script, FALSE);
+}
+
+
+static void remove_folder(gchar *folder)
+{
+	GDir *dir = g_dir_open(folder, 0, NULL);
+	const gchar *name;
+
+	while (dir && (name = g_dir_read_name(dir))) {
+		gchar *path = g_build_filename(folder, name, NULL);
+		if (g_file_test(path, G_FILE_TEST_IS_DIR))
+			remove_folder(path);
+		else {
+			g_unlink(path);
+			g_free(path);
+		}
+	}
+	if (dir)
+		g_dir_close(dir);
+	g_rmdir(folder);
+	g_free(folder);
+}
+
+
+static void run(const char *mode, GPtrArray *filenames)
+{
+	gint64 start;
+	guint compiled = 0, from_disk = 0;
+	int i;
+
+	start = g_get_monotonic_time();
+	for (i = 0; i < RUNS; i++) {
+		lua_State *lua = luaL_newstate();
+
+		if (script_cache_compile(lua, filenames) != 0) {
+			fprintf(stderr, "scripts failed to compile\n");
+			exit(1);
+		}
+		script_cache_get_stats(&compiled, &from_disk);
+		script_cache_clear();
+		lua_close(lua);
+	}
+
+	printf("{\"bench\":\"script_cache\",\"mode\":\"%s\",\"scripts\":%d,\"compiled\":%u,\"from_cache\":%u,\"ms_per_start\":%.3f}\n",
+	       mode, SCRIPTS, compiled, from_disk, (g_get_monotonic_time() - start) / 1000.0 / RUNS);
+}
+
+
+int main(void)
+{
+	gchar *folder = g_dir_make_tmp("devilspie2-bench-XXXXXX", NULL);
+	gchar *cache_home;
+	GPtrArray *filenames = g_ptr_array_new_with_free_func(g_free);
+	int i;
+
+	if (!folder) {
+		fprintf(stderr, "couldn't create a temporary folder\n");
+		return 1;
+	}
+
+	// keep the cache files out of the user's cache folder
+	cache_home = g_build_filename(folder, "cache", NULL);
+	g_setenv("XDG_CACHE_HOME", cache_home, TRUE);
+	g_free(cache_home);
+
+	for (i = 0; i < SCRIPTS; i++) {
+		gchar *name = g_strdup_printf("script-%04d.lua", i);
+		gchar *script = make_script(i);
+
+		write_file(folder, name, script);
+		g_ptr_array_add(filenames, g_build_filename(folder, name, NULL));
+		g_free(script);
+		g_free(name);
+	}
+
+	run("source", filenames);
+
+	script_cache_enable_disk(TRUE);
+	run("rebuild", filenames);
+
+	script_cache_rebuild_done();
+	run("cached", filenames);
+
+	g_ptr_array_free(filenames, TRUE);
+	remove_folder(folder);
+	return 0;
+}
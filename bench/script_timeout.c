@@ -0,0 +1,168 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * Per-script dispatch overhead of the script time-out mechanisms.
+ *
+ * Runs a typical small rule script many times with
+ *   none     - no time-out at all
+ *   alarm    - the old scheme: SIGALRM + alarm() per run, hook on every
+ *              instruction
+ *   deadline - the current scheme: hook every 1000 instructions comparing
+ *              the monotonic clock against a per-run deadline
+ * and prints one JSON object per line.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <lua.h>
+#include <lualib.h>
+#include <lauxlib.h>
+
+#define RUNS 200000
+#define TIMEOUT_SECONDS 5
+
+static const char rule[] =
+	"local name = get_window_name()\n"
+	"if string.find(name, 'Terminal') then\n"
+	"	set_window_workspace(2)\n"
+	"elseif name == 'Firefox' or name == 'Thunderbird' then\n"
+	"	maximize()\n"
+	"end\n";
+
+
+static long long now_ns(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (long long)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+
+static int c_get_window_name(lua_State *lua)
+{
+	lua_pushstring(lua, "xterm");
+	return 1;
+}
+
+
+static int c_nothing(lua_State *lua)
+{
+	return 0;
+}
+
+
+// old scheme
+static volatile sig_atomic_t timedout = 0;
+
+static void timeout_alarm(int sig)
+{
+	timedout = 1;
+}
+
+static void hook_alarm(lua_State *lua, lua_Debug *ar)
+{
+	if (timedout)
+		luaL_error(lua, "script timed out");
+}
+
+
+// new scheme
+static long long deadline = 0;
+
+static void hook_deadline(lua_State *lua, lua_Debug *ar)
+{
+	if (deadline && now_ns() >= deadline)
+		luaL_error(lua, "script timed out");
+}
+
+
+static lua_State *new_state(void)
+{
+	lua_State *lua = luaL_newstate();
+	luaL_openlibs(lua);
+	lua_register(lua, "get_window_name", c_get_window_name);
+	lua_register(lua, "set_window_workspace", c_nothing);
+	lua_register(lua, "maximize", c_nothing);
+	if (luaL_loadstring(lua, rule)) {
+		fprintf(stderr, "%s\n", lua_tostring(lua, -1));
+		exit(1);
+	}
+	return lua;
+}
+
+
+static void run(const char *mode)
+{
+	lua_State *lua = new_state();
+	int chunk = lua_gettop(lua);
+	long long start;
+
+	if (!strcmp(mode, "deadline"))
+		lua_sethook(lua, hook_deadline, LUA_MASKCOUNT, 1000);
+
+	start = now_ns();
+	for (int i = 0; i < RUNS; ++i) {
+		struct sigaction newact, oldact;
+
+		lua_pushvalue(lua, chunk);
+
+		if (!strcmp(mode, "alarm")) {
+			newact.sa_handler = timeout_alarm;
+			sigemptyset(&newact.sa_mask);
+			newact.sa_flags = 0;
+			timedout = 0;
+			lua_sethook(lua, hook_alarm, LUA_MASKCOUNT, 1);
+			sigaction(SIGALRM, &newact, &oldact);
+			alarm(TIMEOUT_SECONDS);
+		} else if (!strcmp(mode, "deadline")) {
+			deadline = now_ns() + TIMEOUT_SECONDS * 1000000000LL;
+		}
+
+		if (lua_pcall(lua, 0, 0, 0)) {
+			fprintf(stderr, "%s\n", lua_tostring(lua, -1));
+			exit(1);
+		}
+
+		if (!strcmp(mode, "alarm")) {
+			alarm(0);
+			sigaction(SIGALRM, &oldact, NULL);
+		} else {
+			deadline = 0;
+		}
+	}
+
+	printf("{\"bench\":\"script_timeout\",\"mode\":\"%s\",\"runs\":%d,\"ns_per_run\":%.1f}\n",
+	       mode, RUNS, (double)(now_ns() - start) / RUNS);
+	lua_close(lua);
+}
+
+
+int main(void)
+{
+	run("none");
+	run("alarm");
+	run("deadline");
+	return 0;
+}
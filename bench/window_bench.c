@@ -0,0 +1,320 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * End-to-end window dispatch benchmark; see bench/run.sh.
+ *
+ *   bench-windows [-w windows] [-c classes] [-l label] -- devilspie2 args...
+ *
+ * Acts as a minimal EWMH window manager (supporting-WM check window and
+ * _NET_CLIENT_LIST), starts the given devilspie2 command, then maps the
+ * given number of windows one at a time, with WM_CLASS cycling through
+ * Bench1 .. Bench<classes>. The rule scripts are expected to set the
+ * _DP2_BENCH property on each window; the time from MapNotify to that
+ * property appearing is the latency.
+ *
+ * Prints one JSON object with latency percentiles and the daemon's CPU
+ * time (user + system) over the measured windows.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+
+#define TIMEOUT_MS 5000
+#define STARTUP_TIMEOUT_MS 30000
+
+static Display *dpy;
+static Window root;
+static Atom atom_client_list, atom_client_list_stacking, atom_marker;
+
+static Window *clients;
+static int n_clients;
+
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+
+/**
+ * Daemon CPU time in ms, from /proc/<pid>/stat (utime + stime).
+ */
+static double cpu_ms(pid_t pid)
+{
+	char path[64], buf[1024];
+	unsigned long utime, stime;
+	FILE *fp;
+	char *p;
+
+	snprintf(path, sizeof(path), "/proc/%ld/stat", (long)pid);
+	fp = fopen(path, "r");
+	if (!fp)
+		return -1;
+	if (!fgets(buf, sizeof(buf), fp)) {
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+
+	// skip "pid (comm)"; comm may contain spaces
+	p = strrchr(buf, ')');
+	if (!p || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2)
+		return -1;
+
+	return (utime + stime) * 1000.0 / sysconf(_SC_CLK_TCK);
+}
+
+
+static void set_client_list(void)
+{
+	XChangeProperty(dpy, root, atom_client_list, XA_WINDOW, 32, PropModeReplace,
+	                (unsigned char *)clients, n_clients);
+	XChangeProperty(dpy, root, atom_client_list_stacking, XA_WINDOW, 32, PropModeReplace,
+	                (unsigned char *)clients, n_clients);
+	XFlush(dpy);
+}
+
+
+/**
+ * Just enough of a window manager for libwnck.
+ */
+static void become_wm(void)
+{
+	Window check = XCreateSimpleWindow(dpy, root, -1, -1, 1, 1, 0, 0, 0);
+	Atom utf8 = XInternAtom(dpy, "UTF8_STRING", False);
+	Atom supported[4];
+	long desktops = 1, desktop = 0;
+
+	XChangeProperty(dpy, check, XInternAtom(dpy, "_NET_SUPPORTING_WM_CHECK", False),
+	                XA_WINDOW, 32, PropModeReplace, (unsigned char *)&check, 1);
+	XChangeProperty(dpy, check, XInternAtom(dpy, "_NET_WM_NAME", False),
+	                utf8, 8, PropModeReplace, (unsigned char *)"bench-wm", 8);
+	XChangeProperty(dpy, root, XInternAtom(dpy, "_NET_SUPPORTING_WM_CHECK", False),
+	                XA_WINDOW, 32, PropModeReplace, (unsigned char *)&check, 1);
+
+	supported[0] = atom_client_list;
+	supported[1] = atom_client_list_stacking;
+	supported[2] = XInternAtom(dpy, "_NET_NUMBER_OF_DESKTOPS", False);
+	supported[3] = XInternAtom(dpy, "_NET_CURRENT_DESKTOP", False);
+	XChangeProperty(dpy, root, XInternAtom(dpy, "_NET_SUPPORTED", False),
+	                XA_ATOM, 32, PropModeReplace, (unsigned char *)supported, 4);
+	XChangeProperty(dpy, root, supported[2], XA_CARDINAL, 32, PropModeReplace,
+	                (unsigned char *)&desktops, 1);
+	XChangeProperty(dpy, root, supported[3], XA_CARDINAL, 32, PropModeReplace,
+	                (unsigned char *)&desktop, 1);
+
+	set_client_list();
+}
+
+
+/**
+ * Wait for an event on w matching type (and, for PropertyNotify, the
+ * marker atom). Returns FALSE on timeout.
+ */
+static int wait_for(Window w, int type, double deadline)
+{
+	struct pollfd pfd = { ConnectionNumber(dpy), POLLIN, 0 };
+	XEvent ev;
+
+	for (;;) {
+		while (XPending(dpy)) {
+			XNextEvent(dpy, &ev);
+			if (ev.xany.window != w || ev.type != type)
+				continue;
+			if (type == PropertyNotify &&
+			    (ev.xproperty.atom != atom_marker || ev.xproperty.state != PropertyNewValue))
+				continue;
+			return 1;
+		}
+
+		double left = deadline - now_ms();
+		if (left <= 0)
+			return 0;
+		poll(&pfd, 1, (int)left + 1);
+	}
+}
+
+
+/**
+ * Map a client window and return its latency in ms (< 0 on timeout).
+ */
+static double run_window(int index, int classes, int timeout)
+{
+	char name[64], class[32];
+	XClassHint hint;
+	Window w;
+	double mapped;
+
+	snprintf(name, sizeof(name), "bench window %d", index);
+	snprintf(class, sizeof(class), "Bench%d", index % classes + 1);
+	hint.res_name = name;
+	hint.res_class = class;
+
+	w = XCreateSimpleWindow(dpy, root, index % 100, index % 100, 200, 100, 0, 0, 0);
+	XSetClassHint(dpy, w, &hint);
+	XStoreName(dpy, w, name);
+	XSelectInput(dpy, w, StructureNotifyMask | PropertyChangeMask);
+	XMapWindow(dpy, w);
+	XFlush(dpy);
+
+	if (!wait_for(w, MapNotify, now_ms() + timeout))
+		return -1;
+	mapped = now_ms();
+
+	// this is what tells libwnck about the window
+	clients = realloc(clients, (n_clients + 1) * sizeof(Window));
+	clients[n_clients++] = w;
+	set_client_list();
+
+	if (!wait_for(w, PropertyNotify, mapped + timeout))
+		return -1;
+
+	return now_ms() - mapped;
+}
+
+
+static void destroy_clients(void)
+{
+	for (int i = 0; i < n_clients; ++i)
+		XDestroyWindow(dpy, clients[i]);
+	n_clients = 0;
+	set_client_list();
+	XSync(dpy, False);
+}
+
+
+static int compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-w windows] [-c classes] [-l label] -- devilspie2 [args...]\n", prog);
+	exit(2);
+}
+
+
+int main(int argc, char *argv[])
+{
+	int windows = 100, classes = 1, opt;
+	const char *label = "";
+	double *latency;
+	int measured = 0, timeouts = 0;
+	double cpu_before, cpu_after;
+	pid_t daemon;
+
+	while ((opt = getopt(argc, argv, "w:c:l:")) != -1) {
+		switch (opt) {
+		case 'w': windows = atoi(optarg); break;
+		case 'c': classes = atoi(optarg); break;
+		case 'l': label = optarg; break;
+		default: usage(argv[0]);
+		}
+	}
+	if (optind >= argc || windows < 1 || classes < 1)
+		usage(argv[0]);
+
+	dpy = XOpenDisplay(NULL);
+	if (!dpy) {
+		fprintf(stderr, "%s: cannot open display\n", argv[0]);
+		return 1;
+	}
+	root = DefaultRootWindow(dpy);
+	atom_client_list = XInternAtom(dpy, "_NET_CLIENT_LIST", False);
+	atom_client_list_stacking = XInternAtom(dpy, "_NET_CLIENT_LIST_STACKING", False);
+	atom_marker = XInternAtom(dpy, "_DP2_BENCH", False);
+
+	become_wm();
+
+	daemon = fork();
+	if (daemon < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (daemon == 0) {
+		execvp(argv[optind], argv + optind);
+		perror(argv[optind]);
+		_exit(127);
+	}
+
+	// warm-up: the first window also tells us that the daemon is ready
+	if (run_window(0, classes, STARTUP_TIMEOUT_MS) < 0) {
+		fprintf(stderr, "%s: devilspie2 didn't handle the first window\n", argv[0]);
+		kill(daemon, SIGTERM);
+		waitpid(daemon, NULL, 0);
+		return 1;
+	}
+	destroy_clients();
+
+	latency = calloc(windows, sizeof(double));
+	cpu_before = cpu_ms(daemon);
+
+	for (int i = 1; i <= windows; ++i) {
+		double t = run_window(i, classes, TIMEOUT_MS);
+		if (t < 0)
+			++timeouts;
+		else
+			latency[measured++] = t;
+	}
+
+	cpu_after = cpu_ms(daemon);
+	destroy_clients();
+
+	kill(daemon, SIGTERM);
+	waitpid(daemon, NULL, 0);
+
+	qsort(latency, measured, sizeof(double), compare_doubles);
+
+	double total = 0;
+	for (int i = 0; i < measured; ++i)
+		total += latency[i];
+
+	printf("{\"bench\":\"window_dispatch\",\"label\":\"%s\",\"classes\":%d,\"windows\":%d,"
+	       "\"timeouts\":%d,\"mean_ms\":%.3f,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"max_ms\":%.3f,"
+	       "\"daemon_cpu_ms\":%.1f}\n",
+	       label, classes, windows, timeouts,
+	       measured ? total / measured : 0.0,
+	       measured ? latency[(measured - 1) / 2] : 0.0,
+	       measured ? latency[(measured * 99 - 1) / 100] : 0.0,
+	       measured ? latency[measured - 1] : 0.0,
+	       cpu_before >= 0 && cpu_after >= 0 ? cpu_after - cpu_before : -1.0);
+
+	free(latency);
+	free(clients);
+	XCloseDisplay(dpy);
+	return timeouts ? 1 : 0;
+}
@@ -0,0 +1,476 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <string.h>
+
+#include <glib.h>
+#include <gdk/gdk.h>
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+
+#include "batch.h"
+#include "xutils.h"
+
+
+enum batch_op_kind {
+	BATCH_GEOMETRY,		// via the window manager
+	BATCH_CONFIGURE,	// directly
+	BATCH_DECORATIONS,
+	BATCH_PROPERTY,
+	BATCH_CALL,
+	BATCH_CALL_BOOL,
+	BATCH_WORKSPACE,
+};
+
+/**
+ *
+ */
+struct batch_op {
+	enum batch_op_kind kind;
+	Window xid;
+	union {
+		struct {
+			WnckWindowGravity gravity;
+			WnckWindowMoveResizeMask mask;
+			int x, y, w, h;
+		} geometry;
+		struct {
+			unsigned int mask;
+			XWindowChanges changes;
+		} configure;
+		gboolean decorated;
+		struct {
+			Atom atom, type;
+			int format, nitems;
+			guchar *data;	// NULL => delete the property
+		} property;
+		struct {
+			batch_window_func func;
+		} call;
+		struct {
+			batch_window_bool_func func;
+			gboolean value;
+		} call_bool;
+		int workspace;
+	} u;
+};
+
+// recorded changes, in the order in which they were made
+static GQueue pending = G_QUEUE_INIT;
+
+static int batch_depth = 0;
+
+
+static void free_op(struct batch_op *op)
+{
+	if (op->kind == BATCH_PROPERTY)
+		g_free(op->u.property.data);
+	g_free(op);
+}
+
+
+/**
+ * Whether an op's position relative to others of the same sort matters.
+ * Properties are independent of everything else. Decorations are not: the
+ * window manager works out the frame from them, so geometry, maximising
+ * etc. must see the decorations which the script asked for before them.
+ */
+static gboolean is_ordered(enum batch_op_kind kind)
+{
+	return kind != BATCH_PROPERTY;
+}
+
+
+/**
+ * Whether an op changes the window's properties (decorations are set
+ * through _MOTIF_WM_HINTS).
+ */
+static gboolean changes_properties(enum batch_op_kind kind)
+{
+	return kind == BATCH_PROPERTY || kind == BATCH_DECORATIONS;
+}
+
+
+/**
+ * Find the pending op which a new op (of kind, for xid) could be merged
+ * with: the latest of the same kind (and, for properties, for the same
+ * atom), unless an order-dependent op for the window comes between them.
+ */
+static GList *find_mergeable(enum batch_op_kind kind, Window xid, Atom atom)
+{
+	GList *link;
+
+	for (link = pending.tail; link; link = link->prev) {
+		struct batch_op *op = link->data;
+
+		if (op->xid != xid)
+			continue;
+		if (op->kind == kind && (kind != BATCH_PROPERTY || op->u.property.atom == atom))
+			return link;
+		if (is_ordered(kind) && is_ordered(op->kind))
+			return NULL;
+	}
+
+	return NULL;
+}
+
+
+/**
+ * Fold old into op, if that makes sense. If it returns TRUE, old is no
+ * longer needed.
+ */
+static gboolean merge_op(struct batch_op *op, const struct batch_op *old)
+{
+	switch (op->kind) {
+	case BATCH_GEOMETRY:
+		// the fields mean different things with different gravities
+		if (op->u.geometry.gravity != old->u.geometry.gravity &&
+		    (op->u.geometry.mask & old->u.geometry.mask) != old->u.geometry.mask)
+			return FALSE;
+		if (!(op->u.geometry.mask & WNCK_WINDOW_CHANGE_X))
+			op->u.geometry.x = old->u.geometry.x;
+		if (!(op->u.geometry.mask & WNCK_WINDOW_CHANGE_Y))
+			op->u.geometry.y = old->u.geometry.y;
+		if (!(op->u.geometry.mask & WNCK_WINDOW_CHANGE_WIDTH))
+			op->u.geometry.w = old->u.geometry.w;
+		if (!(op->u.geometry.mask & WNCK_WINDOW_CHANGE_HEIGHT))
+			op->u.geometry.h = old->u.geometry.h;
+		op->u.geometry.mask |= old->u.geometry.mask;
+		return TRUE;
+
+	case BATCH_CONFIGURE: {
+		unsigned int missing = old->u.configure.mask & ~op->u.configure.mask;
+		XWindowChanges *changes = &op->u.configure.changes;
+
+		if (missing & CWX)
+			changes->x = old->u.configure.changes.x;
+		if (missing & CWY)
+			changes->y = old->u.configure.changes.y;
+		if (missing & CWWidth)
+			changes->width = old->u.configure.changes.width;
+		if (missing & CWHeight)
+			changes->height = old->u.configure.changes.height;
+		if (missing & CWStackMode)
+			changes->stack_mode = old->u.configure.changes.stack_mode;
+		op->u.configure.mask |= old->u.configure.mask;
+		return TRUE;
+	}
+
+	case BATCH_CALL:
+		// doing the same thing twice in a row is pointless
+		return op->u.call.func == old->u.call.func;
+
+	case BATCH_CALL_BOOL:
+		return op->u.call_bool.func == old->u.call_bool.func;
+
+	default:
+		// the new value replaces the old
+		return TRUE;
+	}
+}
+
+
+static void apply_op(const struct batch_op *op)
+{
+	Display *display = gdk_x11_get_default_xdisplay();
+	WnckWindow *window = NULL;
+
+	switch (op->kind) {
+	case BATCH_GEOMETRY:
+	case BATCH_CALL:
+	case BATCH_CALL_BOOL:
+	case BATCH_WORKSPACE:
+		// wnck forgets about windows when they're closed
+		window = wnck_handle_get_window(my_wnck_handle, op->xid);
+		if (!window)
+			return;
+		break;
+	default:
+		break;
+	}
+
+	switch (op->kind) {
+	case BATCH_GEOMETRY:
+		wnck_window_set_geometry(window, op->u.geometry.gravity, op->u.geometry.mask,
+		                         op->u.geometry.x, op->u.geometry.y,
+		                         op->u.geometry.w, op->u.geometry.h);
+		break;
+
+	case BATCH_CONFIGURE:
+		XConfigureWindow(display, op->xid, op->u.configure.mask,
+		                 (XWindowChanges *)&op->u.configure.changes);
+		break;
+
+	case BATCH_DECORATIONS:
+		set_window_decorations(op->xid, op->u.decorated);
+		break;
+
+	case BATCH_PROPERTY:
+		property_cache_forget(op->xid, op->u.property.atom);
+		if (op->u.property.data)
+			XChangeProperty(display, op->xid, op->u.property.atom,
+			                op->u.property.type, op->u.property.format,
+			                PropModeReplace, op->u.property.data,
+			                op->u.property.nitems);
+		else
+			XDeleteProperty(display, op->xid, op->u.property.atom);
+		break;
+
+	case BATCH_CALL:
+		op->u.call.func(window);
+		break;
+
+	case BATCH_CALL_BOOL:
+		op->u.call_bool.func(window, op->u.call_bool.value);
+		break;
+
+	case BATCH_WORKSPACE: {
+		WnckScreen *screen = wnck_window_get_screen(window);
+		WnckWorkspace *workspace = wnck_screen_get_workspace(screen, op->u.workspace);
+
+		if (workspace && workspace != wnck_window_get_workspace(window))
+			wnck_window_move_to_workspace(window, workspace);
+		break;
+	}
+	}
+}
+
+
+/**
+ * Record a change (taking ownership of op), merging it with an earlier one
+ * where possible; outside a batch, send it now. A merged change takes the
+ * earlier one's place, so that nothing else moves.
+ * Returns FALSE, dropping op, if the window is known to have gone.
+ */
+static gboolean add_op(struct batch_op *op)
+{
+	Atom atom = op->kind == BATCH_PROPERTY ? op->u.property.atom : None;
+	GList *link;
+
+	// there's no point in changing a window which has been closed
+	if (!wnck_handle_get_window(my_wnck_handle, op->xid)) {
+		free_op(op);
+		return FALSE;
+	}
+
+	link = find_mergeable(op->kind, op->xid, atom);
+
+	if (link && merge_op(op, link->data)) {
+		free_op(link->data);
+		link->data = op;
+	} else {
+		g_queue_push_tail(&pending, op);
+	}
+
+	if (!batch_depth)
+		batch_flush();
+	return TRUE;
+}
+
+
+static struct batch_op *new_op(enum batch_op_kind kind, Window xid)
+{
+	struct batch_op *op = g_new0(struct batch_op, 1);
+
+	op->kind = kind;
+	op->xid = xid;
+	return op;
+}
+
+
+/**
+ *
+ */
+void batch_begin(void)
+{
+	++batch_depth;
+}
+
+
+/**
+ *
+ */
+void batch_end(void)
+{
+	if (batch_depth == 0 || --batch_depth)
+		return;
+
+	batch_flush();
+}
+
+
+/**
+ * Send everything recorded so far. Errors are dropped, not reported: the
+ * trap is popped without waiting for the X server, so they only arrive
+ * later, when nobody is asking.
+ */
+void batch_flush(void)
+{
+	struct batch_op *op;
+
+	if (g_queue_is_empty(&pending))
+		return;
+
+	devilspie2_error_trap_push();
+
+	while ((op = g_queue_pop_head(&pending))) {
+		apply_op(op);
+		free_op(op);
+	}
+
+	XFlush(gdk_x11_get_default_xdisplay());
+
+	// nothing here needs a reply, so don't wait for one
+	devilspie2_error_trap_pop_ignored();
+}
+
+
+/**
+ * Send everything recorded so far if any of it would change the window's
+ * properties; used before reading one, so that scripts see their own
+ * changes.
+ */
+void batch_flush_window(Window xid)
+{
+	GList *link;
+
+	for (link = pending.head; link; link = link->next) {
+		const struct batch_op *op = link->data;
+
+		if (op->xid == xid && changes_properties(op->kind)) {
+			batch_flush();
+			return;
+		}
+	}
+}
+
+
+/**
+ * Move and/or resize, via the window manager.
+ */
+gboolean batch_set_geometry(WnckWindow *window, WnckWindowGravity gravity,
+                            WnckWindowMoveResizeMask mask, int x, int y, int w, int h)
+{
+	struct batch_op *op = new_op(BATCH_GEOMETRY, wnck_window_get_xid(window));
+
+	op->u.geometry.gravity = gravity;
+	op->u.geometry.mask = mask;
+	op->u.geometry.x = x;
+	op->u.geometry.y = y;
+	op->u.geometry.w = w;
+	op->u.geometry.h = h;
+	return add_op(op);
+}
+
+
+/**
+ * Move, resize and/or restack directly, as XConfigureWindow().
+ * Only CWX, CWY, CWWidth, CWHeight and CWStackMode (without sibling) may
+ * be used.
+ */
+gboolean batch_configure(Window xid, unsigned int mask, const XWindowChanges *changes)
+{
+	struct batch_op *op = new_op(BATCH_CONFIGURE, xid);
+
+	op->u.configure.mask = mask;
+	op->u.configure.changes = *changes;
+	return add_op(op);
+}
+
+
+/**
+ *
+ */
+gboolean batch_set_decorated(Window xid, gboolean decorated)
+{
+	struct batch_op *op = new_op(BATCH_DECORATIONS, xid);
+
+	op->u.decorated = decorated;
+	return add_op(op);
+}
+
+
+/**
+ * Replace a property, as XChangeProperty(); the data is copied.
+ * As with Xlib, format 32 data is an array of longs.
+ */
+gboolean batch_change_property(Window xid, Atom atom, Atom type, int format,
+                               const void *data, int nitems)
+{
+	struct batch_op *op = new_op(BATCH_PROPERTY, xid);
+	gsize unit = format == 32 ? sizeof(long) : format == 16 ? sizeof(short) : 1;
+
+	op->u.property.atom = atom;
+	op->u.property.type = type;
+	op->u.property.format = format;
+	op->u.property.nitems = nitems;
+	// never NULL, even for no data
+	op->u.property.data = g_malloc(unit * nitems + 1);
+	memcpy(op->u.property.data, data, unit * nitems);
+	return add_op(op);
+}
+
+
+/**
+ *
+ */
+gboolean batch_delete_property(Window xid, Atom atom)
+{
+	struct batch_op *op = new_op(BATCH_PROPERTY, xid);
+
+	op->u.property.atom = atom;
+	return add_op(op);
+}
+
+
+/**
+ * Call one of the wnck_window_* functions which take no other parameters.
+ */
+gboolean batch_call(WnckWindow *window, batch_window_func func)
+{
+	struct batch_op *op = new_op(BATCH_CALL, wnck_window_get_xid(window));
+
+	op->u.call.func = func;
+	return add_op(op);
+}
+
+
+/**
+ * Call one of the wnck_window_* functions which take a boolean.
+ */
+gboolean batch_call_bool(WnckWindow *window, batch_window_bool_func func, gboolean value)
+{
+	struct batch_op *op = new_op(BATCH_CALL_BOOL, wnck_window_get_xid(window));
+
+	op->u.call_bool.func = func;
+	op->u.call_bool.value = value;
+	return add_op(op);
+}
+
+
+/**
+ * Move to a workspace (numbered from 0).
+ */
+gboolean batch_set_workspace(WnckWindow *window, int number)
+{
+	struct batch_op *op = new_op(BATCH_WORKSPACE, wnck_window_get_xid(window));
+
+	op->u.workspace = number;
+	return add_op(op);
+}
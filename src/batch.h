@@ -0,0 +1,58 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __HEADER_BATCH_
+#define __HEADER_BATCH_
+
+#include <glib.h>
+#include <X11/Xlib.h>
+#define WNCK_I_KNOW_THIS_IS_UNSTABLE
+#include <libwnck/libwnck.h>
+
+/**
+ * Batch of window changes.
+ * While a batch is open (a script is running), changes made by script
+ * functions are recorded rather than sent; when the last batch is closed
+ * they are sent together, without waiting for the X server, and those
+ * which supersede earlier ones (xy() then xywh(), or setting a property
+ * twice) are merged. Errors (usually because the window has gone) are
+ * ignored, so the script functions which record changes can't report
+ * them. Outside a batch, changes are sent straight away.
+ * Recording a change returns FALSE, and drops it, if wnck has already seen
+ * the window go; that is the one failure which can be told straight away.
+ */
+typedef void (*batch_window_func)(WnckWindow *window);
+typedef void (*batch_window_bool_func)(WnckWindow *window, gboolean value);
+
+void batch_begin(void);
+void batch_end(void);
+void batch_flush(void);
+void batch_flush_window(Window xid);
+
+gboolean batch_set_geometry(WnckWindow *window, WnckWindowGravity gravity,
+                            WnckWindowMoveResizeMask mask, int x, int y, int w, int h);
+gboolean batch_configure(Window xid, unsigned int mask, const XWindowChanges *changes);
+gboolean batch_set_decorated(Window xid, gboolean decorated);
+gboolean batch_change_property(Window xid, Atom atom, Atom type, int format,
+                               const void *data, int nitems);
+gboolean batch_delete_property(Window xid, Atom atom);
+gboolean batch_call(WnckWindow *window, batch_window_func func);
+gboolean batch_call_bool(WnckWindow *window, batch_window_bool_func func, gboolean value);
+gboolean batch_set_workspace(WnckWindow *window, int number);
+
+#endif /*__HEADER_BATCH_*/
@@ -32,15 +32,17 @@
 #include <lauxlib.h>
 
 #include "script.h"
+#include "script_cache.h"
 #include "script_functions.h"
+#include "xutils.h"
 #include "logger.h"
 
 #include "config.h"
+#include "event_queue.h"
 
 /**
  *
  */
-GSList *event_lists[W_NUM_EVENTS] = { NULL, NULL, NULL, NULL, NULL };
 const char *const event_names[W_NUM_EVENTS] = {
 	"window_open",
 	"window_close",
@@ -49,33 +51,226 @@ const char *const event_names[W_NUM_EVENTS] = {
 	"window_name_change",
 };
 
+/**
+ * Handler scripts define functions with these names instead of acting
+ * whenever they're run; each function is called for its event.
+ */
+const char *const handler_names[W_NUM_EVENTS] = {
+	"on_open",
+	"on_close",
+	"on_focus",
+	"on_blur",
+	"on_name_change",
+};
+
+/**
+ * Coalescing delays (ms) from the event_delay table in devilspie2.lua:
+ *   event_delay = { window_name_change = 100, window_focus = 50 }
+ * Open and close events are never delayed.
+ */
+#define DEFAULT_NAME_CHANGE_DELAY 100
+
+guint event_delays[W_NUM_EVENTS] = { 0, 0, 0, 0, DEFAULT_NAME_CHANGE_DELAY };
+guint geometry_change_delay = 0;
+
+/**
+ * Match declarations from the script_match table in devilspie2.lua:
+ *   script_match = { ["firefox.lua"] = { class = "Firefox", role = "browser" } }
+ * A script with a declaration is only run for windows which match it; each
+ * declared key may be a string or a list of alternative strings.
+ */
+static const char *const match_key_names[MATCH_NUM_KEYS] = {
+	"class",
+	"instance",
+	"role",
+	"type",
+};
+
+struct script_match {
+	GSList *values[MATCH_NUM_KEYS];	// NULL if not constrained
+};
+
+/**
+ * Everything read from devilspie2.lua. On a reload, a new set is built
+ * aside and only put in use once it has been read and its scripts
+ * compiled without error.
+ *
+ * The scripts are kept in one array, sorted by file name (which is the
+ * order in which they are run), each with a mask of the events it is run
+ * for; index finds a script by its (case-folded) file name.
+ */
+struct ruleset {
+	GArray *scripts;	// struct script_desc
+	GHashTable *index;	// case-folded file name -> array index + 1
+	guint event_counts[W_NUM_EVENTS];
+	guint event_delays[W_NUM_EVENTS];
+	guint geometry_change_delay;
+	// case-folded file name -> struct script_match
+	GHashTable *script_matches;
+	// per key: value -> list of struct script_match, each filed under one key only
+	GHashTable *match_index[MATCH_NUM_KEYS];
+	gboolean match_needs_role;
+	// set if scripts_window_open wasn't given: every script in the folder is
+	// then run on window open, and the list follows the folder's contents
+	gchar *greedy_folder;
+};
+
+static struct ruleset *rules = NULL;
+
 
 /**
- * filename_list_sortfunc
- *   function to sort the inserted filenames, to be able to determine
+ * script_sortfunc
+ *   function to sort the scripts by file name, to be able to determine
  *   which order files are loaded.
  */
-static gint filename_list_sortfunc(gconstpointer a,gconstpointer b)
+static gint script_sortfunc(gconstpointer a, gconstpointer b)
 {
-	gchar *file1 = (gchar*)a;
-	gchar *file2 = (gchar*)b;
+	const struct script_desc *script1 = a;
+	const struct script_desc *script2 = b;
 
-	return g_ascii_strcasecmp(file1, file2);
+	return g_ascii_strcasecmp(script1->filename, script2->filename);
+}
+
+
+static void clear_script(gpointer data)
+{
+	g_free(((struct script_desc *)data)->filename);
 }
 
 
 /**
- *
+ *  find_script
+ * Look up a script by file name, ignoring case
+ */
+static struct script_desc *find_script(struct ruleset *rs, const gchar *filename)
+{
+	gchar *key = g_ascii_strdown(filename, -1);
+	guint found = GPOINTER_TO_UINT(g_hash_table_lookup(rs->index, key));
+
+	g_free(key);
+	return found ? &g_array_index(rs->scripts, struct script_desc, found - 1) : NULL;
+}
+
+
+/**
+ *  add_script
+ * Add a script (taking the file name) to the rule set as listed for an
+ * event, or just add the event if it's already there. The array is left
+ * unsorted. Returns the script, valid until the next addition.
+ */
+static struct script_desc *add_script(struct ruleset *rs, gchar *filename, win_event_type event)
+{
+	struct script_desc *script = find_script(rs, filename);
+
+	if (script) {
+		g_free(filename);
+	} else {
+		struct script_desc new_script = { filename, 0, 0, 0, NULL };
+
+		g_array_append_val(rs->scripts, new_script);
+		g_hash_table_insert(rs->index, g_ascii_strdown(filename, -1),
+		                    GUINT_TO_POINTER(rs->scripts->len));
+		script = &g_array_index(rs->scripts, struct script_desc, rs->scripts->len - 1);
+	}
+
+	if (event != W_NUM_EVENTS)
+		script->listed |= EVENT_BIT(event);
+	script->events = script->listed;
+	return script;
+}
+
+
+/**
+ *  get_script_handlers
+ * Find which of the handler functions a script's source defines, so which
+ * events it may handle: "function on_open(", "function M.on_open(" or
+ * "on_open = function", other than after "--" on the same line. This can
+ * still count more than it defines (in code which isn't run, say); which
+ * functions it really has is only known once it has been run, and is
+ * looked at by run_handler() for each event.
+ */
+static guint get_script_handlers(const gchar *filename)
+{
+	static GRegex *regex = NULL;
+	GMatchInfo *match_info;
+	gchar *source = NULL;
+	guint handlers = 0;
+
+	if (!regex)
+		regex = g_regex_new("^[ \\t]*function[ \\t]+(?:[A-Za-z_][A-Za-z0-9_]*[.:])*(on_[a-z_]+)[ \\t]*\\("
+		                    "|^(?:(?!--).)*?\\b(on_[a-z_]+)[ \\t]*=[ \\t]*function\\b",
+		                    G_REGEX_MULTILINE | G_REGEX_OPTIMIZE, 0, NULL);
+
+	if (!g_file_get_contents(filename, &source, NULL, NULL))
+		return 0;
+
+	g_regex_match(regex, source, 0, &match_info);
+	while (g_match_info_matches(match_info)) {
+		gchar *name = g_match_info_fetch(match_info, 1);
+		win_event_type event;
+
+		if (!name || !*name) {
+			g_free(name);
+			name = g_match_info_fetch(match_info, 2);
+		}
+
+		for (event = 0; event < W_NUM_EVENTS; event++)
+			if (g_strcmp0(name, handler_names[event]) == 0)
+				handlers |= EVENT_BIT(event);
+
+		g_free(name);
+		g_match_info_next(match_info, NULL);
+	}
+	g_match_info_free(match_info);
+	g_free(source);
+
+	return handlers;
+}
+
+/**
+ *  set_script_handlers
+ * Record which handler functions a script may define, and so which events
+ * it's for: those it's listed for and those it may have handlers for. A
+ * script found in the folder rather than listed is also run on window open
+ * unless it turns out to have handler functions.
  */
-static GSList *add_lua_file_to_list(GSList *list, const gchar *script_folder, const gchar *filename)
+static void set_script_handlers(struct script_desc *script, guint handlers)
 {
-	gchar *added_filename = g_build_path(G_DIR_SEPARATOR_S,script_folder, filename, NULL);
+	script->handlers = handlers;
+	script->events = script->listed | handlers;
+	if (!script->listed)
+		script->events |= EVENT_BIT(W_OPEN);
+}
+
+
+/**
+ *  index_ruleset
+ * Rebuild the index once the array has been sorted or changed, and point
+ * each script at its match declaration
+ */
+static void index_ruleset(struct ruleset *rs)
+{
+	win_event_type event;
+	guint i;
+
+	g_hash_table_remove_all(rs->index);
+	for (event = 0; event < W_NUM_EVENTS; event++)
+		rs->event_counts[event] = 0;
+
+	for (i = 0; i < rs->scripts->len; i++) {
+		struct script_desc *script = &g_array_index(rs->scripts, struct script_desc, i);
+		gchar *key = g_ascii_strdown(script->filename, -1);
 
-	list = g_slist_insert_sorted( list, added_filename, filename_list_sortfunc);
+		script->match = g_hash_table_lookup(rs->script_matches, key);
+		g_hash_table_insert(rs->index, key, GUINT_TO_POINTER(i + 1));
 
-	return list;
+		for (event = 0; event < W_NUM_EVENTS; event++)
+			if (script->events & EVENT_BIT(event))
+				rs->event_counts[event]++;
+	}
 }
 
+
 static gboolean get_lua_table(lua_State *luastate, gchar *table_name)
 {
 	if (luastate == NULL) return FALSE;
@@ -101,14 +296,15 @@ static gchar * get_single_script_name(lua_State *luastate, gchar *table_name)
 }
 
 /**
- *
+ *  add_table_of_strings
+ * Add the scripts named in a table (or a single string) for an event
  */
-static GSList *get_table_of_strings(lua_State *luastate,
-                                    gchar *script_folder,
-                                    gchar *table_name)
+static void add_table_of_strings(struct ruleset *rs,
+                                 lua_State *luastate,
+                                 gchar *script_folder,
+                                 gchar *table_name,
+                                 win_event_type event)
 {
-	GSList *list = NULL;
-
 	if (get_lua_table(luastate, table_name)) {
 
 		lua_pushnil(luastate);
@@ -117,7 +313,7 @@ static GSList *get_table_of_strings(lua_State *luastate,
 			if (lua_isstring(luastate, -1)) {
 				char *temp = (char *)lua_tostring(luastate, -1);
 
-				list = add_lua_file_to_list(list, script_folder, temp);
+				add_script(rs, g_build_path(G_DIR_SEPARATOR_S, script_folder, temp, NULL), event);
 			}
 			lua_pop(luastate, 1);
 		}
@@ -127,55 +323,66 @@ static GSList *get_table_of_strings(lua_State *luastate,
 		gchar * oneFileString = get_single_script_name(luastate, table_name);
 		if(oneFileString != NULL && strlen(oneFileString) > 0)
 		{
-			list = add_lua_file_to_list(list, script_folder, oneFileString);
+			add_script(rs, g_build_path(G_DIR_SEPARATOR_S, script_folder, oneFileString, NULL), event);
 		}
 	}
-
-	return list;
 }
 
 
 /**
- *  is_in_list
- * Go through _one_ list, and check if the filename is in this list
+ *  is_in_any_list
+ * Check if the file is already run for any event
  */
-static gboolean is_in_list(GSList *list, const gchar *filename)
+gboolean is_in_any_list(const gchar *filename)
 {
-	gboolean result = FALSE;
-
-	if (list) {
-		GSList *temp_list = list;
+	return rules && find_script(rules, filename) != NULL;
+}
 
-		while (temp_list) {
-			gchar *list_filename = (gchar*)temp_list->data;
-			if (list_filename) {
 
-				if (g_ascii_strcasecmp(list_filename, filename) == 0) {
-					result = TRUE;
-				}
-			}
-			temp_list = temp_list->next;
-		}
+/**
+ *  get_scripts
+ * The scripts in use, in the order in which they are to be run
+ */
+const struct script_desc *get_scripts(guint *count)
+{
+	if (!rules) {
+		*count = 0;
+		return NULL;
 	}
 
-	return result;
+	*count = rules->scripts->len;
+	return (const struct script_desc *)rules->scripts->data;
 }
 
 
 /**
- *  is_in_any_list
- * Go through our lists, and check if the file is already in any of them
+ *  have_scripts_for
+ * Check whether any script is run for an event
  */
-gboolean is_in_any_list(const gchar *filename)
+gboolean have_scripts_for(win_event_type event)
 {
-	win_event_type i;
+	return rules && rules->event_counts[event] != 0;
+}
 
-	for (i=0; i < W_NUM_EVENTS; i++) {
-		if (is_in_list(event_lists[i], filename))
-			return TRUE;
+
+/**
+ *  is_greedy_candidate
+ * Check whether a file in the folder belongs in the greedily-loaded list
+ */
+static gboolean is_greedy_candidate(struct ruleset *rs,
+                                    const gchar *script_folder, const gchar *name)
+{
+	gboolean result = FALSE;
+
+	// we only bother with *.lua in the folder
+	// we also ignore dot files
+	if (name[0] != '.' && g_str_has_suffix(name, ".lua")) {
+		gchar *filename = g_build_path(G_DIR_SEPARATOR_S, script_folder, name, NULL);
+		result = find_script(rs, filename) == NULL;
+		g_free(filename);
 	}
 
-	return FALSE;
+	return result;
 }
 
 /**
@@ -184,87 +391,391 @@ gboolean is_in_any_list(const gchar *filename)
  * If it's defined at all, the greedy loading will be suppressed.
  * The variable can be a single file ref or multiple, or defined to be empty (table or string) 
  */
-static gboolean should_greedy_load_scripts(lua_State *luastate)
+static gboolean should_greedy_load_scripts(struct ruleset *rs, lua_State *luastate)
 {
-	if(event_lists[W_OPEN] != NULL) return FALSE; // Multiple files were listed
+	guint i;
+
+	for (i = 0; i < rs->scripts->len; i++)
+		if (g_array_index(rs->scripts, struct script_desc, i).listed & EVENT_BIT(W_OPEN))
+			return FALSE; // Multiple files were listed
+
 	if(get_lua_table(luastate, "scripts_window_open")) return FALSE; // Defined, but was an empty table
 	if(get_single_script_name(luastate, "scripts_window_open")) return FALSE; // Defined as an empty string
 
 	return TRUE;
 }
 
+static void free_script_match(gpointer data)
+{
+	struct script_match *match = data;
+	match_key_type key;
+
+	for (key = 0; key < MATCH_NUM_KEYS; key++)
+		g_slist_free_full(match->values[key], g_free);
+	g_free(match);
+}
+
+
+static void free_match_index_entry(gpointer data)
+{
+	g_slist_free((GSList *)data);
+}
+
+
 /**
- *  load_config
- * Load configuration from a file - From this we set up the lists of files
- * which decides what script to load on what wnck event.
+ * Read one key of a match declaration; the table is at the top of the stack.
+ * Values are case-folded, as they are compared without regard to case.
  */
-int load_config(gchar *filename)
+static GSList *get_match_values(lua_State *luastate, const char *key)
+{
+	GSList *values = NULL;
+
+	lua_getfield(luastate, -1, key);
+
+	if (lua_type(luastate, -1) == LUA_TSTRING) {
+		values = g_slist_prepend(values, g_ascii_strdown(lua_tostring(luastate, -1), -1));
+	} else if (lua_istable(luastate, -1)) {
+		lua_pushnil(luastate);
+		while (lua_next(luastate, -2)) {
+			if (lua_type(luastate, -1) == LUA_TSTRING)
+				values = g_slist_prepend(values, g_ascii_strdown(lua_tostring(luastate, -1), -1));
+			lua_pop(luastate, 1);
+		}
+	}
+
+	lua_pop(luastate, 1);
+	return values;
+}
+
+
+/**
+ *  load_event_delays
+ * Read the event_delay table; anything not given gets its default
+ */
+static void load_event_delays(struct ruleset *rs, lua_State *luastate)
+{
+	win_event_type i;
+
+	lua_getglobal(luastate, "event_delay");
+
+	if (lua_istable(luastate, -1)) {
+		for (i = W_FOCUS; i < W_NUM_EVENTS; i++) {
+			lua_getfield(luastate, -1, event_names[i]);
+			if (lua_isnumber(luastate, -1) && lua_tonumber(luastate, -1) >= 0)
+				rs->event_delays[i] = lua_tonumber(luastate, -1);
+			lua_pop(luastate, 1);
+		}
+
+		lua_getfield(luastate, -1, "geometry_change");
+		if (lua_isnumber(luastate, -1) && lua_tonumber(luastate, -1) >= 0)
+			rs->geometry_change_delay = lua_tonumber(luastate, -1);
+		lua_pop(luastate, 1);
+	}
+
+	lua_pop(luastate, 1);
+}
+
+
+/**
+ *  load_script_matches
+ * Read the script_match table and build the per-key indexes
+ */
+static void load_script_matches(struct ruleset *rs, lua_State *luastate,
+                                const gchar *script_folder)
+{
+	lua_getglobal(luastate, "script_match");
+
+	if (lua_istable(luastate, -1)) {
+		lua_pushnil(luastate);
+
+		while (lua_next(luastate, -2)) {
+			if (lua_type(luastate, -2) == LUA_TSTRING && lua_istable(luastate, -1)) {
+				struct script_match *match = g_new0(struct script_match, 1);
+				match_key_type key, index_key = MATCH_NUM_KEYS;
+
+				for (key = 0; key < MATCH_NUM_KEYS; key++) {
+					match->values[key] = get_match_values(luastate, match_key_names[key]);
+					if (match->values[key] && index_key == MATCH_NUM_KEYS)
+						index_key = key;
+				}
+
+				if (index_key == MATCH_NUM_KEYS) {
+					// nothing declared; treat as unconstrained
+					free_script_match(match);
+				} else {
+					gchar *filename = g_build_path(G_DIR_SEPARATOR_S, script_folder,
+					                               lua_tostring(luastate, -2), NULL);
+					// case-folded, as for looking up scripts
+					gchar *key = g_ascii_strdown(filename, -1);
+					GSList *value;
+
+					g_free(filename);
+
+					/*
+					 * The same script under two spellings; the indexes
+					 * borrow the first declaration's strings, so it stays.
+					 */
+					if (g_hash_table_contains(rs->script_matches, key)) {
+						logger_err_printf(_("script_match: %s is given more than once; only one declaration is used\n"),
+						                  lua_tostring(luastate, -2));
+						free_script_match(match);
+						g_free(key);
+						lua_pop(luastate, 1);
+						continue;
+					}
+
+					if (match->values[MATCH_ROLE])
+						rs->match_needs_role = TRUE;
+
+					g_hash_table_insert(rs->script_matches, key, match);
+
+					for (value = match->values[index_key]; value; value = value->next) {
+						GSList *list = g_hash_table_lookup(rs->match_index[index_key], value->data);
+						// the list is owned by the hash table; prepending changes its head
+						g_hash_table_steal(rs->match_index[index_key], value->data);
+						g_hash_table_insert(rs->match_index[index_key], value->data,
+						                    g_slist_prepend(list, match));
+					}
+				}
+			}
+			lua_pop(luastate, 1);
+		}
+	}
+
+	lua_pop(luastate, 1);
+}
+
+
+static gboolean match_values_contain(GSList *values, const gchar *value)
+{
+	if (!values)
+		return TRUE; // unconstrained
+
+	for (; values; values = values->next)
+		if (g_ascii_strcasecmp(values->data, value) == 0)
+			return TRUE;
+
+	return FALSE;
+}
+
+
+/**
+ *  get_match_candidates
+ * Find the match declarations which match this window.
+ * Returns NULL if no script has a match declaration, in which case every
+ * script is a candidate; else a set to be tested with is_match_candidate()
+ * and freed with g_hash_table_destroy().
+ */
+GHashTable *get_match_candidates(WnckWindow *window)
+{
+	if (!rules || g_hash_table_size(rules->script_matches) == 0)
+		return NULL;
+
+	GHashTable *candidates = g_hash_table_new(NULL, NULL);
+	const gchar *keys[MATCH_NUM_KEYS] = { NULL, };
+	gchar *role = NULL;
+	match_key_type key;
+
+	if (!window)
+		return candidates;
+
+	keys[MATCH_CLASS] = get_window_class_name(window);
+#ifdef WNCK_MAJOR_VERSION
+	keys[MATCH_INSTANCE] = wnck_window_get_class_instance_name(window);
+#endif
+	if (rules->match_needs_role)
+		role = my_wnck_get_string_property(wnck_window_get_xid(window),
+		                                   atom_get(ATOM_WM_WINDOW_ROLE), NULL);
+	keys[MATCH_ROLE] = role ? role : "";
+	keys[MATCH_TYPE] = get_window_type_name(window);
+
+	for (key = 0; key < MATCH_NUM_KEYS; key++) {
+		GSList *list;
+		gchar *folded;
+
+		if (!keys[key])
+			continue;
+
+		// the index is keyed by the case-folded values
+		folded = g_ascii_strdown(keys[key], -1);
+		list = g_hash_table_lookup(rules->match_index[key], folded);
+		g_free(folded);
+
+		for (; list; list = list->next) {
+			struct script_match *match = list->data;
+			match_key_type check;
+			gboolean matched = TRUE;
+
+			for (check = 0; check < MATCH_NUM_KEYS && matched; check++)
+				matched = match_values_contain(match->values[check], keys[check] ? keys[check] : "");
+			if (matched)
+				g_hash_table_add(candidates, match);
+		}
+	}
+
+	g_free(role);
+	return candidates;
+}
+
+
+/**
+ *  is_match_candidate
+ * Check whether a script should run, given the result of get_match_candidates()
+ */
+gboolean is_match_candidate(GHashTable *candidates, const struct script_desc *script)
+{
+	if (!candidates || !script->match)
+		return TRUE;
+
+	return g_hash_table_contains(candidates, script->match);
+}
+
+
+/**
+ *  new_ruleset
+ * An empty rule set, with the default delays
+ */
+static struct ruleset *new_ruleset()
+{
+	struct ruleset *rs = g_new0(struct ruleset, 1);
+	match_key_type key;
+
+	rs->scripts = g_array_new(FALSE, FALSE, sizeof(struct script_desc));
+	g_array_set_clear_func(rs->scripts, clear_script);
+	rs->index = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+	rs->event_delays[W_NAME_CHANGED] = DEFAULT_NAME_CHANGE_DELAY;
+
+	// the indexes borrow their keys from script_matches
+	rs->script_matches = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_script_match);
+	for (key = 0; key < MATCH_NUM_KEYS; key++)
+		rs->match_index[key] = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, free_match_index_entry);
+
+	return rs;
+}
+
+
+/**
+ *  free_ruleset
+ */
+static void free_ruleset(struct ruleset *rs)
+{
+	match_key_type key;
+
+	if (!rs)
+		return;
+
+	g_array_free(rs->scripts, TRUE);
+	g_hash_table_destroy(rs->index);
+
+	for (key = 0; key < MATCH_NUM_KEYS; key++)
+		g_hash_table_destroy(rs->match_index[key]);
+	g_hash_table_destroy(rs->script_matches);
+
+	g_free(rs->greedy_folder);
+	g_free(rs);
+}
+
+
+/**
+ *  install_ruleset
+ * Put the given rule set in use; returns the previous one
+ */
+static struct ruleset *install_ruleset(struct ruleset *rs)
+{
+	struct ruleset *previous = rules;
+
+	rules = rs;
+	memcpy(event_delays, rs->event_delays, sizeof(event_delays));
+	geometry_change_delay = rs->geometry_change_delay;
+
+	return previous;
+}
+
+
+/**
+ *  load_ruleset
+ * Load configuration from a file - From this we set up the list of files
+ * and which decides what script to load on what wnck event.
+ * Returns NULL on error.
+ */
+static struct ruleset *load_ruleset(gchar *filename)
 {
 	lua_State *config_lua_state = NULL;
-	int result = 0;
+	struct ruleset *rs = NULL;
 	const gchar *current_file = NULL;
-	GSList *temp_window_open_file_list = NULL;
+	guint i;
 
 	// First get list of Lua files in folder - Then read variables from
 	// devilspie2.lua and put the files in the required lists.
 
 	gchar *script_folder = g_path_get_dirname(filename);
 
-	GDir *dir = g_dir_open(script_folder, 0, NULL);
 	if (!g_file_test(script_folder, G_FILE_TEST_IS_DIR)) {
 
 		printf("%s\n", _("script_folder isn't a folder."));
-		return -1;
+		g_free(script_folder);
+		return NULL;
 	}
 
+	GDir *dir = g_dir_open(script_folder, 0, NULL);
+
+	rs = new_ruleset();
 	config_lua_state = init_script(script_folder);
 
 	if (g_file_test(filename, G_FILE_TEST_EXISTS)) {
 
 		if (run_script(config_lua_state, filename) != 0) {
 			logger_err_printf(_("Error: %s\n"), filename);
-			result = -1;
+			free_ruleset(rs);
+			rs = NULL;
 			goto EXITPOINT;
 		}
 
-		event_lists[W_OPEN] = get_table_of_strings(config_lua_state,
-		                         script_folder,
-		                         "scripts_window_open");
-		event_lists[W_CLOSE] = get_table_of_strings(config_lua_state,
-		                         script_folder,
-		                         "scripts_window_close");
-		event_lists[W_FOCUS] = get_table_of_strings(config_lua_state,
-		                         script_folder,
-		                         "scripts_window_focus");
-		event_lists[W_BLUR]  = get_table_of_strings(config_lua_state,
-		                         script_folder,
-		                         "scripts_window_blur");
-		event_lists[W_NAME_CHANGED] = get_table_of_strings(config_lua_state,
-		                         script_folder,
-		                         "scripts_window_name_change");
+		add_table_of_strings(rs, config_lua_state, script_folder,
+		                     "scripts_window_open", W_OPEN);
+		add_table_of_strings(rs, config_lua_state, script_folder,
+		                     "scripts_window_close", W_CLOSE);
+		add_table_of_strings(rs, config_lua_state, script_folder,
+		                     "scripts_window_focus", W_FOCUS);
+		add_table_of_strings(rs, config_lua_state, script_folder,
+		                     "scripts_window_blur", W_BLUR);
+		add_table_of_strings(rs, config_lua_state, script_folder,
+		                     "scripts_window_name_change", W_NAME_CHANGED);
+
+		load_script_matches(rs, config_lua_state, script_folder);
+		load_event_delays(rs, config_lua_state);
+	}
+
+	// listed scripts may also have handlers for other events
+	for (i = 0; i < rs->scripts->len; i++) {
+		struct script_desc *script = &g_array_index(rs->scripts, struct script_desc, i);
+		set_script_handlers(script, get_script_handlers(script->filename));
 	}
 
 	/*
 	Allow the user to specify a limited set of files, as there might be .lua files being used in
 	"require"s or some other files the user may not want to be executed.
 	*/
-	if(should_greedy_load_scripts(config_lua_state))
+	if(should_greedy_load_scripts(rs, config_lua_state))
 	{
-		// add the files in the folder to our linked list
-		while ((current_file = g_dir_read_name(dir))) {
-
-			// we only bother with *.lua in the folder
-			// we also ignore dot files
-			if (current_file[0] != '.' && g_str_has_suffix(current_file, ".lua")) {
-				if (!is_in_any_list(current_file)) {
-					temp_window_open_file_list =
-						add_lua_file_to_list(temp_window_open_file_list, script_folder, current_file);
-				}
+		// add the files in the folder to our list
+		while (dir && (current_file = g_dir_read_name(dir))) {
+			if (is_greedy_candidate(rs, script_folder, current_file)) {
+				struct script_desc *script =
+					add_script(rs, g_build_path(G_DIR_SEPARATOR_S, script_folder, current_file, NULL),
+					           W_NUM_EVENTS);
+				set_script_handlers(script, get_script_handlers(script->filename));
 			}
 		}
 
-		event_lists[W_OPEN] = temp_window_open_file_list;
+		rs->greedy_folder = g_strdup(script_folder);
 	}
+
+	// sorting once is cheaper than keeping things sorted as they are added
+	g_array_sort(rs->scripts, script_sortfunc);
+	index_ruleset(rs);
+
 EXITPOINT:
 	g_free(script_folder);
 	if (config_lua_state)
@@ -272,22 +783,145 @@ EXITPOINT:
 	if (dir)
 		g_dir_close(dir);
 
-	return result;
+	return rs;
+}
+
+
+/**
+ *  compile_ruleset
+ * Compile every script named in the rule set which exists. A script which
+ * doesn't compile is reported and keeps its previous version, if any; it
+ * doesn't stop the rule set from being used, as it may well have nothing
+ * to do with what has changed in it.
+ */
+static void compile_ruleset(struct ruleset *rs, lua_State *lua)
+{
+	GPtrArray *filenames = g_ptr_array_sized_new(rs->scripts->len);
+	guint failed, i;
+
+	for (i = 0; i < rs->scripts->len; i++)
+		g_ptr_array_add(filenames, g_array_index(rs->scripts, struct script_desc, i).filename);
+
+	// files which don't exist are reported if and when they are run
+	failed = script_cache_compile(lua, filenames);
+	if (failed)
+		logger_err_printf(_("%u script(s) didn't compile; their previous versions, if any, are used\n"), failed);
+
+	g_ptr_array_free(filenames, TRUE);
 }
 
 
+/**
+ *  load_config
+ * Read the configuration and put it in use
+ */
+int load_config(gchar *filename)
+{
+	return reload_config(filename, NULL);
+}
+
 
 /**
- *
+ *  reload_config
+ * Read the configuration and, if lua is given, compile the scripts in it
+ * in that state. The rules in use are only replaced if the configuration
+ * can be read.
  */
-static void unallocate_file_list(GSList *file_list)
+int reload_config(gchar *filename, lua_State *lua)
 {
-	if (file_list) {
-		while(file_list) {
-			g_free ((gchar*)file_list->data);
-			file_list = file_list->next;
-		}
+	struct ruleset *rs = load_ruleset(filename);
+
+	if (!rs)
+		return -1;
+
+	if (lua)
+		compile_ruleset(rs, lua);
+
+	// events queued under the old rules (for scripts which may be gone)
+	event_queue_clear();
+	free_ruleset(install_ruleset(rs));
+	return 0;
+}
+
+
+/**
+ *  add_script_file
+ * A file has appeared in the script folder; if every script in the folder
+ * is run, add it.
+ * Returns TRUE if the scripts were changed.
+ */
+gboolean add_script_file(const gchar *name)
+{
+	struct script_desc script = { NULL, 0, 0, 0, NULL };
+	guint i;
+
+	if (!rules || !rules->greedy_folder || !is_greedy_candidate(rules, rules->greedy_folder, name))
+		return FALSE;
+
+	script.filename = g_build_path(G_DIR_SEPARATOR_S, rules->greedy_folder, name, NULL);
+	set_script_handlers(&script, get_script_handlers(script.filename));
+
+	for (i = 0; i < rules->scripts->len; i++) {
+		if (script_sortfunc(&script, &g_array_index(rules->scripts, struct script_desc, i)) < 0)
+			break;
 	}
+	g_array_insert_val(rules->scripts, i, script);
+	index_ruleset(rules);
+
+	return TRUE;
+}
+
+
+/**
+ *  remove_script_file
+ * A file has gone from the script folder; drop it if it was only there
+ * because every script in the folder is run.
+ * Returns TRUE if the scripts were changed.
+ */
+gboolean remove_script_file(const gchar *name)
+{
+	struct script_desc *script;
+	gchar *filename;
+
+	if (!rules || !rules->greedy_folder)
+		return FALSE;
+
+	filename = g_build_path(G_DIR_SEPARATOR_S, rules->greedy_folder, name, NULL);
+	script = find_script(rules, filename);
+	g_free(filename);
+
+	if (!script || script->listed)
+		return FALSE;
+
+	g_array_remove_index(rules->scripts, script - (struct script_desc *)rules->scripts->data);
+	index_ruleset(rules);
+
+	return TRUE;
+}
+
+
+/**
+ *  rescan_script_file
+ * A script has changed; check which handler functions it now defines.
+ * Returns TRUE if that has changed which events it's for.
+ */
+gboolean rescan_script_file(const gchar *filename)
+{
+	struct script_desc *script = rules ? find_script(rules, filename) : NULL;
+	guint handlers, events;
+
+	if (!script)
+		return FALSE;
+
+	handlers = get_script_handlers(script->filename);
+	if (handlers == script->handlers)
+		return FALSE;
+
+	events = script->events;
+	set_script_handlers(script, handlers);
+	index_ruleset(rules);
+
+	return events != script->events;
 }
 
 
@@ -296,13 +930,6 @@ static void unallocate_file_list(GSList *file_list)
  */
 void clear_file_lists()
 {
-	win_event_type i = 0;
-
-	for (i = 0; i < W_NUM_EVENTS; i++) {
-		if (event_lists[i]) {
-			unallocate_file_list(event_lists[i]);
-			g_slist_free(event_lists[i]);
-			event_lists[i] = NULL;
-		}
-	}
+	free_ruleset(rules);
+	rules = NULL;
 }
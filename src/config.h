@@ -20,13 +20,21 @@
 #define __HEADER_CONFIG_
 
 #include "glib.h"
+#define WNCK_I_KNOW_THIS_IS_UNSTABLE
+#include <libwnck/libwnck.h>
+#include <lua.h>
 
 int load_config(gchar *config_filename);
+int reload_config(gchar *config_filename, lua_State *lua);
 
 void clear_file_lists();
 
 gboolean is_in_any_list(const gchar *filename);
 
+gboolean add_script_file(const gchar *name);
+gboolean remove_script_file(const gchar *name);
+gboolean rescan_script_file(const gchar *filename);
+
 typedef enum {
 	W_OPEN,
 	W_CLOSE,
@@ -36,8 +44,42 @@ typedef enum {
 	W_NUM_EVENTS /* keep this at the end */
 } win_event_type;
 
-extern GSList *event_lists[W_NUM_EVENTS];
+typedef enum {
+	MATCH_CLASS,
+	MATCH_INSTANCE,
+	MATCH_ROLE,
+	MATCH_TYPE,
+	MATCH_NUM_KEYS /* keep this at the end */
+} match_key_type;
+
+#define EVENT_BIT(event) (1u << (event))
+
+struct script_match;
+
+/**
+ * A script which is run for some event, with its match declaration if any.
+ * A script which defines handler functions (on_open() etc.) is run once to
+ * define them, and then they are called instead; it is still run as a whole
+ * for any later event it is listed for but has no function for.
+ */
+struct script_desc {
+	gchar *filename;
+	guint events;	// EVENT_BIT() of each event it is run for
+	guint listed;	// EVENT_BIT() of each event it is listed for in devilspie2.lua
+	guint handlers;	// EVENT_BIT() of each handler function its source defines
+	const struct script_match *match;
+};
+
+const struct script_desc *get_scripts(guint *count);
+gboolean have_scripts_for(win_event_type event);
+
+GHashTable *get_match_candidates(WnckWindow *window);
+gboolean is_match_candidate(GHashTable *candidates, const struct script_desc *script);
+
 extern const char *const event_names[W_NUM_EVENTS];
+extern const char *const handler_names[W_NUM_EVENTS];
+extern guint event_delays[W_NUM_EVENTS];
+extern guint geometry_change_delay;
 
 // Our git version which is defined through some magic in the build system
 extern const char *gitversion;
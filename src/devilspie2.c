@@ -25,6 +25,7 @@
 #include <gdk/gdk.h>
 #include <gdk/gdkx.h>
 #include <glib/gi18n.h>
+#include <glib-unix.h>
 
 #define WNCK_I_KNOW_THIS_IS_UNSTABLE
 #include <libwnck/libwnck.h>
@@ -36,12 +37,18 @@
 #include <locale.h>
 
 #include "script.h"
+#include "script_cache.h"
 #include "script_functions.h"
 #include "logger.h"
 
 #include "error_strings.h"
 
 #include "config.h"
+#include "xutils.h"
+#include "event_queue.h"
+#include "stats.h"
+#include "process_info.h"
+#include "window_index.h"
 
 
 #if (GTK_MAJOR_VERSION >= 3)
@@ -67,6 +74,17 @@ static gboolean show_wnck_version = FALSE;
 
 static gboolean show_lua_version = FALSE;
 
+static gboolean use_script_cache = FALSE;
+static gboolean rebuild_script_cache = FALSE;
+
+static gboolean show_stats = FALSE;
+
+// folder changes are applied once none has been seen for this long (ms)
+#define DEFAULT_RELOAD_DELAY 250
+static gint reload_delay = DEFAULT_RELOAD_DELAY;
+static GHashTable *pending_changes = NULL;	// names of changed files
+static guint pending_changes_source = 0;
+
 static gchar *script_folder = NULL;
 static gchar *temp_folder = NULL;
 
@@ -74,56 +92,107 @@ GFileMonitor *mon = NULL;
 
 gchar *config_filename = NULL;
 
-WnckHandle *my_wnck_handle = NULL;
-
 /**
  *
  */
 static void load_list_of_scripts(WnckScreen *screen G_GNUC_UNUSED, WnckWindow *window,
-                                 GSList *file_list)
+                                 win_event_type event)
 {
-	GSList *temp_file_list = file_list;
+	const struct script_desc *scripts;
+	GHashTable *candidates;
+	guint count, i;
+	gint64 start;
+
+	if (!have_scripts_for(event))
+		return;
+
+	start = g_get_monotonic_time();
+
 	// set the window to work on
 	set_current_window(window);
 
-	// for every file in the folder - load the script
-	while(temp_file_list) {
-		gchar *filename = (gchar*)temp_file_list->data;
+	// share X property reads between all scripts run for this event
+	property_cache_begin(window ? wnck_window_get_xid(window) : None);
 
-		// is it a Lua file?
-		if (g_str_has_suffix((gchar*)filename, ".lua")) {
+	// skip scripts whose match declarations rule this window out
+	candidates = get_match_candidates(window);
 
-			// init the script, run it
-			if (!run_script(global_lua_state, filename))
-				/**/;
+	// for every file for this event - load the script
+	scripts = get_scripts(&count);
+	for (i = 0; i < count; i++) {
+		const struct script_desc *script = &scripts[i];
+
+		// is it a Lua file?
+		if ((script->events & EVENT_BIT(event)) &&
+		    g_str_has_suffix(script->filename, ".lua") &&
+		    is_match_candidate(candidates, script)) {
+
+			// init the script, run it (or its handler)
+			if (!script->handlers) {
+				run_script(global_lua_state, script->filename);
+			} else {
+				switch (run_handler(global_lua_state, script->filename, handler_names[event])) {
+				case HANDLER_NOT_DEFINED:
+					// run as a whole only for the events it's listed for
+					if (script->listed & EVENT_BIT(event))
+						run_script(global_lua_state, script->filename);
+					break;
+				case HANDLER_NONE:
+					// not a handler script after all
+					if (script->listed ? script->listed & EVENT_BIT(event) : event == W_OPEN)
+						run_script(global_lua_state, script->filename);
+					break;
+				case HANDLER_SET_UP:
+					// it has just been run as a whole, for this window
+					break;
+				default:
+					break;
+				}
+			}
 
 		}
-		temp_file_list=temp_file_list->next;
 	}
+
+	if (candidates)
+		g_hash_table_destroy(candidates);
+
+	property_cache_end();
+
+	stats_record_event(event, g_get_monotonic_time() - start);
 	return;
 
 }
 
 
+/**
+ * Run the scripts for a queued event; data is the event type.
+ */
+static void dispatch_event(WnckWindow *window, gpointer data)
+{
+	win_event_type event = GPOINTER_TO_INT(data);
+
+	load_list_of_scripts(window ? wnck_window_get_screen(window) : NULL,
+	                     window, event);
+}
+
+
 static void window_name_changed_cb(WnckWindow *window)
 {
 	WnckScreen * screen = wnck_window_get_screen(window);
 	if(screen == NULL) return;
 
 	// Handle duplicate name-change events
-	// Simple method: just track the most recent event regardless of window
-	static WnckWindow *previous = NULL;
-	static char *prevname = NULL;
-
+	// The last name seen is kept with each window
 	const char *newname = wnck_window_get_name(window);
-	if (window == previous && prevname && !strcmp (prevname, newname))
+	const char *prevname = g_object_get_data(G_OBJECT(window), "devilspie2-name");
+	if (prevname && !g_strcmp0(prevname, newname))
 		return;
 	// Store the info for the next event
-	free(prevname);
-	prevname = strdup(newname);
-	previous = window;
+	g_object_set_data_full(G_OBJECT(window), "devilspie2-name", g_strdup(newname), g_free);
 
-	load_list_of_scripts(screen, window, event_lists[W_NAME_CHANGED]);
+	if (have_scripts_for(W_NAME_CHANGED))
+		event_queue_add(window, event_delays[W_NAME_CHANGED],
+		                dispatch_event, GINT_TO_POINTER(W_NAME_CHANGED));
 }
 
 /**
@@ -131,7 +200,17 @@ static void window_name_changed_cb(WnckWindow *window)
  */
 static void window_opened_cb(WnckScreen *screen, WnckWindow *window)
 {
-	load_list_of_scripts(screen, window, event_lists[W_OPEN]);
+	// keep property reads for the window until they change
+	window_state_track(wnck_window_get_xid(window));
+	window_index_add(window);
+
+	if (have_scripts_for(W_OPEN)) {
+		// fetch the usual properties in one round trip
+		property_cache_begin(wnck_window_get_xid(window));
+		property_cache_prefetch(wnck_window_get_xid(window));
+		load_list_of_scripts(screen, window, W_OPEN);
+		property_cache_end();
+	}
 	/*
 	Attach a listener to each window for window-specific changes
 	Safe to do this way as long as the 'user data' parameter is NULL
@@ -145,7 +224,37 @@ static void window_opened_cb(WnckScreen *screen, WnckWindow *window)
  */
 static void window_closed_cb(WnckScreen *screen, WnckWindow *window)
 {
-	load_list_of_scripts(screen, window, event_lists[W_CLOSE]);
+	// anything still pending is of no further interest
+	event_queue_forget_window(window);
+
+	// wnck no longer lists it as open, so find_windows() shouldn't either
+	window_index_remove(window);
+
+	load_list_of_scripts(screen, window, W_CLOSE);
+
+	// sleeping scripts and after() functions for the window won't be resumed
+	script_forget_window(window);
+
+	// the pid may be reused
+	process_info_forget(wnck_window_get_pid(window));
+
+	window_state_forget(wnck_window_get_xid(window));
+}
+
+
+/**
+ * Queue a focus or blur event. If the opposite event is still pending for
+ * the same window then the two cancel out.
+ */
+static void queue_focus_event(WnckWindow *window, win_event_type event)
+{
+	win_event_type opposite = (event == W_FOCUS) ? W_BLUR : W_FOCUS;
+
+	if (event_queue_cancel(window, dispatch_event, GINT_TO_POINTER(opposite)))
+		return;
+
+	if (have_scripts_for(event))
+		event_queue_add(window, event_delays[event], dispatch_event, GINT_TO_POINTER(event));
 }
 
 
@@ -156,9 +265,9 @@ static void window_changed_cb(WnckScreen *screen, WnckWindow *window)
 {
 	WnckWindow *cur;
 
-	load_list_of_scripts(screen, window, event_lists[W_BLUR]);
+	queue_focus_event(window, W_BLUR);
 	cur = wnck_screen_get_active_window(screen);
-	load_list_of_scripts(screen, cur, event_lists[W_FOCUS]);
+	queue_focus_event(cur, W_FOCUS);
 }
 
 
@@ -194,7 +303,13 @@ void init_screens()
  */
 void devilspie_exit()
 {
+	if (show_stats)
+		stats_dump();
 	clear_file_lists();
+	if (pending_changes_source)
+		g_source_remove(pending_changes_source);
+	if (pending_changes)
+		g_hash_table_destroy(pending_changes);
 	g_free(temp_folder);
 	if (mon)
 		g_object_unref(mon);
@@ -218,23 +333,39 @@ static void signal_handler(int sig)
 
 
 /**
- *
+ * SIGUSR1: print the timing statistics
  */
-static void print_list(GSList *list)
+static gboolean dump_stats_cb(gpointer data G_GNUC_UNUSED)
 {
-	GSList *temp_list;
-	if (list != NULL) {
-		temp_list = list;
+	stats_dump();
+	return TRUE;
+}
 
-		while(temp_list) {
-			gchar *file_name = temp_list->data;
 
-			if (file_name) {
-				if (g_str_has_suffix((gchar*)file_name, ".lua")) {
-					logger_printf("%s\n", (gchar*)file_name);
-				}
-			}
-			temp_list = temp_list->next;
+/**
+ * SIGTERM: leave the main loop so that we exit cleanly
+ */
+static gboolean terminate_cb(gpointer data G_GNUC_UNUSED)
+{
+	if (loop)
+		g_main_loop_quit(loop);
+	return TRUE;
+}
+
+
+/**
+ *
+ */
+static void print_list(win_event_type event)
+{
+	const struct script_desc *scripts;
+	guint count, i;
+
+	scripts = get_scripts(&count);
+	for (i = 0; i < count; i++) {
+		if ((scripts[i].events & EVENT_BIT(event)) &&
+		    g_str_has_suffix(scripts[i].filename, ".lua")) {
+			logger_printf("%s\n", scripts[i].filename);
 		}
 	}
 }
@@ -251,14 +382,12 @@ static void print_script_lists()
 	logger_print("------------\n");
 
 	for (i = 0; i < W_NUM_EVENTS; i++) {
-		if (event_lists[i])
+		if (have_scripts_for(i))
 			have_any_files = TRUE;
 		// If we are running debug mode - print the list of files:
 		logger_printf(_("List of Lua files handling \"%s\" events in folder:\n"),
 		              event_names[i]);
-		if (event_lists[i]) {
-			print_list(event_lists[i]);
-		}
+		print_list(i);
 	}
 
 	if (!have_any_files) {
@@ -268,19 +397,48 @@ static void print_script_lists()
 }
 
 /**
-Reload the config and re-initialise the Lua VM
+ * Compile every listed script up front (or fetch it from the on-disk
+ * cache) so that the first burst of window-opened events doesn't have to.
+ */
+static void preload_scripts()
+{
+	gint64 start = g_get_monotonic_time();
+	const struct script_desc *scripts;
+	GPtrArray *filenames;
+	guint compiled, from_disk;
+	guint count, i;
+
+	scripts = get_scripts(&count);
+	filenames = g_ptr_array_sized_new(count);
+	for (i = 0; i < count; i++)
+		g_ptr_array_add(filenames, scripts[i].filename);
+
+	// errors are reported now and again when the script is run
+	script_cache_compile(global_lua_state, filenames);
+	g_ptr_array_free(filenames, TRUE);
+
+	// --rebuild-cache is for this pass only, not every reload after it
+	script_cache_rebuild_done();
+
+	script_cache_get_stats(&compiled, &from_disk);
+	logger_printf(_("Scripts loaded in %.1f ms (%u compiled, %u from cache)\n"),
+	              (g_get_monotonic_time() - start) / 1000.0, compiled, from_disk);
+}
+
+/**
+Reload the config. The Lua VM, with anything the scripts have set up in it
+(on_geometry_changed callbacks, pending after() calls), is kept, and so are
+the current rules if the new ones can't be read. A script which doesn't
+compile keeps its previous version.
  */
 void refresh_config_and_script()
 {
-	clear_file_lists();
 	set_current_window(NULL);
-	
-	if (load_config(config_filename) != 0) {
-		logger_print_always("Configuration file cannot be re-loaded. Processing will not continue until the error is corrected.\n");
+
+	if (reload_config(config_filename, global_lua_state) != 0) {
+		logger_print_always("Configuration file cannot be re-loaded. The previous configuration remains in use until the error is corrected.\n");
 		return;
 	}
-	
-	global_lua_state = reinit_script(global_lua_state, script_folder);
 
 	logger_print("Files in folder updated!\n - new lists:\n\n");
 
@@ -290,7 +448,73 @@ void refresh_config_and_script()
 }
 
 /**
- *
+ * Bring one changed script up to date. A script which doesn't compile
+ * (perhaps because it is only partly written) is left as it was.
+ */
+static void refresh_script(const gchar *short_filename)
+{
+	// named as in the file lists
+	gchar *full_path = g_build_path(G_DIR_SEPARATOR_S, script_folder, short_filename, NULL);
+
+	if (!g_file_test(full_path, G_FILE_TEST_EXISTS)) {
+		script_cache_invalidate(full_path);
+		// if every script is run on window open, that list follows the folder
+		if (remove_script_file(short_filename))
+			logger_printf("Removed %s\n", full_path);
+	} else if (is_in_any_list(full_path)) {
+		if (script_cache_refresh(global_lua_state, full_path) != 0) {
+			logger_err_printf("%s\n", lua_tostring(global_lua_state, -1));
+			lua_pop(global_lua_state, 1);
+		} else if (rescan_script_file(full_path)) {
+			// it has gained or lost handler functions
+			logger_printf("Events changed for %s\n", full_path);
+		}
+	} else {
+		gchar *module_name = g_strndup(short_filename, strlen(short_filename) - 4);
+
+		// luaL_loadfile, as for require(); it isn't cached
+		if (luaL_loadfile(global_lua_state, full_path) != 0) {
+			logger_err_printf("%s\n", lua_tostring(global_lua_state, -1));
+		} else if (add_script_file(short_filename)) {
+			logger_printf("Added %s\n", full_path);
+		} else if (unload_module(global_lua_state, module_name)) {
+			// the next require() will reload it
+			logger_printf("Module %s will be reloaded\n", module_name);
+		}
+		lua_pop(global_lua_state, 1);
+		g_free(module_name);
+	}
+
+	g_free(full_path);
+}
+
+/**
+ * Apply the folder changes seen since the last time, all at once
+ */
+static gboolean apply_folder_changes(gpointer data G_GNUC_UNUSED)
+{
+	GHashTable *changes = pending_changes;
+	GHashTableIter iter;
+	gpointer name;
+
+	pending_changes = NULL;
+	pending_changes_source = 0;
+
+	// devilspie2.lua decides which files are run for which events
+	if (g_hash_table_remove(changes, "devilspie2.lua"))
+		refresh_config_and_script();
+
+	g_hash_table_iter_init(&iter, changes);
+	while (g_hash_table_iter_next(&iter, &name, NULL))
+		refresh_script(name);
+
+	g_hash_table_destroy(changes);
+	return FALSE;
+}
+
+/**
+ * Editors tend to produce several events per save; note which files have
+ * changed and wait for things to settle.
  */
 void folder_changed_callback(GFileMonitor *mon G_GNUC_UNUSED,
                              GFile *first_file,
@@ -298,37 +522,31 @@ void folder_changed_callback(GFileMonitor *mon G_GNUC_UNUSED,
                              GFileMonitorEvent event,
                              gpointer user_data)
 {
-	// If a file is created or deleted, we need to check the file lists again
-	if ((event == G_FILE_MONITOR_EVENT_CREATED) ||
-	    (event == G_FILE_MONITOR_EVENT_DELETED))
-	{
-		refresh_config_and_script();
-	}
+	gchar *short_filename;
 
-	// Also monitor if our devilspie2.lua file is changed - since it handles
-	// which files are window close or window open scripts.
-	if (event == G_FILE_MONITOR_EVENT_CHANGED) {
-		if (first_file) {
-			gchar *short_filename = g_file_get_basename(first_file);
-			gchar *full_path = g_file_get_path(first_file);
+	if (!first_file)
+		return;
 
-			if (g_strcmp0(short_filename, "devilspie2.lua")==0)
-			{
-				refresh_config_and_script();
-			}
-			else if( g_str_has_suffix((gchar*)short_filename, ".lua") && is_in_any_list(full_path) == FALSE)
-			{	// May be a module file 
-				gchar * module_name = g_utf8_substring(short_filename, 0, strlen(short_filename) - 4);
-				if(is_module_loaded(global_lua_state, module_name) == TRUE)
-				{
-					global_lua_state = reinit_script(global_lua_state, script_folder);
-				}
-				g_free(module_name);
-			}
-			g_free(short_filename);
-			g_free(full_path);
-		}
+	if ((event != G_FILE_MONITOR_EVENT_CREATED) &&
+	    (event != G_FILE_MONITOR_EVENT_DELETED) &&
+	    (event != G_FILE_MONITOR_EVENT_CHANGED) &&
+	    (event != G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT) &&
+	    (event != G_FILE_MONITOR_EVENT_ATTRIBUTE_CHANGED))
+		return;
+
+	short_filename = g_file_get_basename(first_file);
+	if (short_filename[0] == '.' || !g_str_has_suffix(short_filename, ".lua")) {
+		g_free(short_filename);
+		return;
 	}
+
+	if (!pending_changes)
+		pending_changes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+	g_hash_table_add(pending_changes, short_filename);
+
+	if (pending_changes_source)
+		g_source_remove(pending_changes_source);
+	pending_changes_source = g_timeout_add(reload_delay, apply_folder_changes, NULL);
 }
 
 /**
@@ -363,6 +581,18 @@ int main(int argc, char *argv[])
 		{ "lua-version",  'l', 0, G_OPTION_ARG_NONE,   &show_lua_version,
 		  N_("Show Lua version and quit"), NULL
 		},
+		{ "cache",        'c', 0, G_OPTION_ARG_NONE,   &use_script_cache,
+		  N_("Keep compiled scripts in the user's cache folder"), NULL
+		},
+		{ "rebuild-cache", 0,  0, G_OPTION_ARG_NONE,   &rebuild_script_cache,
+		  N_("Recompile all scripts and refresh the cache (implies --cache)"), NULL
+		},
+		{ "stats",        0,   0, G_OPTION_ARG_NONE,   &show_stats,
+		  N_("Print script timing statistics on exit"), NULL
+		},
+		{ "reload-delay", 0,   0, G_OPTION_ARG_INT,    &reload_delay,
+		  N_("Wait this long after a script changes before reloading it (default 250)"), N_("MS")
+		},
 		{ NULL }
 	};
 
@@ -424,6 +654,11 @@ int main(int argc, char *argv[])
 	if (shown)
 		exit(0);
 
+	if (reload_delay < 0) {
+		printf("%s\n", _("The reload delay can't be negative."));
+		exit(EXIT_FAILURE);
+	}
+
 	gdk_init(&argc, &argv);
 
 	g_free(full_desc_string);
@@ -512,10 +747,14 @@ int main(int argc, char *argv[])
 	g_signal_connect(mon, "changed", G_CALLBACK(folder_changed_callback),
 	                 (gpointer)(config_filename));
 
+	if (use_script_cache || rebuild_script_cache)
+		script_cache_enable_disk(rebuild_script_cache);
+
 	global_lua_state = init_script(script_folder);
 	if (logtofifo)
 		logger_create(global_lua_state);
 	print_script_lists();
+	preload_scripts();
 
 	logger_print("------------\n");
 
@@ -532,6 +771,10 @@ int main(int argc, char *argv[])
 		exit(EXIT_FAILURE);
 	}
 
+	g_unix_signal_add(SIGUSR1, dump_stats_cb, NULL);
+	g_unix_signal_add(SIGTERM, terminate_cb, NULL);
+
+	xutils_init();
 	my_wnck_handle = wnck_handle_new(WNCK_CLIENT_TYPE_PAGER);
 	init_screens();
 
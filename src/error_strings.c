@@ -39,6 +39,9 @@ gchar *string_expected_as_indata_error = NULL;
 gchar *number_or_string_expected_as_indata_error = NULL;
 gchar *number_or_string_or_boolean_expected_as_indata_error = NULL;
 
+gchar *table_expected_as_indata_error = NULL;
+gchar *unknown_key_error = NULL;
+
 gchar *integer_greater_than_zero_expected_error = NULL;
 gchar *could_not_find_current_viewport_error = NULL;
 
@@ -78,6 +81,9 @@ int init_script_error_messages()
 	INIT_ERRMSG(number_or_string_expected_as_indata_error,  _("Number or string expected as parameter"));
 	INIT_ERRMSG(number_or_string_or_boolean_expected_as_indata_error,  _("Number or string or boolean expected as parameter"));
 
+	INIT_ERRMSG(table_expected_as_indata_error,             _("Table expected as parameter"));
+	INIT_ERRMSG(unknown_key_error,                          _("Unknown key"));
+
 	INIT_ERRMSG(integer_greater_than_zero_expected_error,   _("Integer greater than zero expected"));
 	INIT_ERRMSG(could_not_find_current_viewport_error,      _("Could not find current viewport"));
 	INIT_ERRMSG(setting_viewport_failed_error,              _("Setting viewport failed"));
@@ -109,6 +115,9 @@ void done_script_error_messages()
 	g_free(number_or_string_expected_as_indata_error);
 	g_free(number_or_string_or_boolean_expected_as_indata_error);
 
+	g_free(table_expected_as_indata_error);
+	g_free(unknown_key_error);
+
 	g_free(integer_greater_than_zero_expected_error);
 	g_free(could_not_find_current_viewport_error);
 	g_free(setting_viewport_failed_error);
@@ -38,6 +38,9 @@ extern gchar *string_expected_as_indata_error;
 extern gchar *number_or_string_expected_as_indata_error;
 extern gchar *number_or_string_or_boolean_expected_as_indata_error;
 
+extern gchar *table_expected_as_indata_error;
+extern gchar *unknown_key_error;
+
 extern gchar *integer_greater_than_zero_expected_error;
 extern gchar *could_not_find_current_viewport_error;
 
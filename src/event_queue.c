@@ -0,0 +1,181 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+
+#include "event_queue.h"
+
+
+/**
+ *
+ */
+struct queued_event {
+	WnckWindow *window;
+	queued_event_func func;
+	gpointer data;
+	gint64 due;	// monotonic time, microseconds
+};
+
+// pending events, in the order in which they arrived
+static GQueue pending = G_QUEUE_INIT;
+
+static guint timer_id = 0;
+static gint64 timer_due = 0;
+
+
+static GList *find_event(WnckWindow *window, queued_event_func func, gpointer data)
+{
+	GList *link;
+
+	for (link = pending.head; link; link = link->next) {
+		struct queued_event *event = link->data;
+		if (event->window == window && event->func == func && event->data == data)
+			return link;
+	}
+
+	return NULL;
+}
+
+
+static void schedule(void);
+
+static gboolean dispatch(gpointer data G_GNUC_UNUSED)
+{
+	timer_id = 0;
+
+	// run whatever is due; restart the scan each time in case the queue
+	// was changed by the event
+	for (;;) {
+		gint64 now = g_get_monotonic_time();
+		GList *link;
+
+		for (link = pending.head; link; link = link->next)
+			if (((struct queued_event *)link->data)->due <= now)
+				break;
+		if (!link)
+			break;
+
+		struct queued_event *event = link->data;
+		g_queue_delete_link(&pending, link);
+		event->func(event->window, event->data);
+		g_free(event);
+	}
+
+	schedule();
+	return FALSE;
+}
+
+
+/**
+ * Make sure that the timer will fire when the earliest event is due.
+ */
+static void schedule(void)
+{
+	gint64 earliest = G_MAXINT64;
+	GList *link;
+
+	for (link = pending.head; link; link = link->next) {
+		struct queued_event *event = link->data;
+		if (event->due < earliest)
+			earliest = event->due;
+	}
+
+	if (timer_id) {
+		if (timer_due <= earliest)
+			return;
+		g_source_remove(timer_id);
+		timer_id = 0;
+	}
+
+	if (earliest == G_MAXINT64)
+		return;
+
+	gint64 wait = earliest - g_get_monotonic_time();
+	timer_due = earliest;
+	timer_id = wait > 0
+	           ? g_timeout_add((guint)((wait + 999) / 1000), dispatch, NULL)
+	           : g_idle_add(dispatch, NULL);
+}
+
+
+/**
+ * Queue an event, unless the same one is already pending.
+ */
+void event_queue_add(WnckWindow *window, guint delay, queued_event_func func, gpointer data)
+{
+	if (find_event(window, func, data))
+		return;
+
+	struct queued_event *event = g_new(struct queued_event, 1);
+	event->window = window;
+	event->func = func;
+	event->data = data;
+	event->due = g_get_monotonic_time() + (gint64)delay * 1000;
+	g_queue_push_tail(&pending, event);
+
+	schedule();
+}
+
+
+/**
+ * Drop a pending event. Returns TRUE if there was one.
+ */
+gboolean event_queue_cancel(WnckWindow *window, queued_event_func func, gpointer data)
+{
+	GList *link = find_event(window, func, data);
+
+	if (!link)
+		return FALSE;
+
+	g_free(link->data);
+	g_queue_delete_link(&pending, link);
+	return TRUE;
+}
+
+
+/**
+ * Drop all pending events for a window which is going away.
+ */
+void event_queue_forget_window(WnckWindow *window)
+{
+	GList *link = pending.head;
+
+	while (link) {
+		GList *next = link->next;
+		if (((struct queued_event *)link->data)->window == window) {
+			g_free(link->data);
+			g_queue_delete_link(&pending, link);
+		}
+		link = next;
+	}
+}
+
+
+/**
+ * Drop everything; used when the scripts are reloaded.
+ */
+void event_queue_clear(void)
+{
+	g_queue_foreach(&pending, (GFunc)g_free, NULL);
+	g_queue_clear(&pending);
+	if (timer_id) {
+		g_source_remove(timer_id);
+		timer_id = 0;
+	}
+}
@@ -0,0 +1,39 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __HEADER_EVENT_QUEUE_
+#define __HEADER_EVENT_QUEUE_
+
+#include <glib.h>
+#define WNCK_I_KNOW_THIS_IS_UNSTABLE
+#include <libwnck/libwnck.h>
+
+/**
+ * Queue of deferred window events.
+ * An event is identified by (window, func, data); adding one which is
+ * already pending does nothing, so bursts of the same event collapse into
+ * one call, made at most 'delay' ms after the first of them.
+ */
+typedef void (*queued_event_func)(WnckWindow *window, gpointer data);
+
+void event_queue_add(WnckWindow *window, guint delay, queued_event_func func, gpointer data);
+gboolean event_queue_cancel(WnckWindow *window, queued_event_func func, gpointer data);
+void event_queue_forget_window(WnckWindow *window);
+void event_queue_clear(void);
+
+#endif /*__HEADER_EVENT_QUEUE_*/
@@ -0,0 +1,202 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <glib.h>
+
+#include "process_info.h"
+
+// none of the files which we read should be anywhere near this size
+#define PROC_FILE_MAX 65536
+
+
+// pid -> struct process_info
+static GHashTable *process_cache = NULL;
+
+
+static void free_process_info(gpointer data)
+{
+	struct process_info *info = data;
+
+	g_free(info->comm);
+	g_free(info->exe);
+	g_strfreev(info->argv);
+	g_free(info->cgroup);
+	g_free(info);
+}
+
+
+/**
+ * Read /proc/<pid>/<name>; returns NULL on failure, else a NUL-terminated
+ * buffer (which may contain other NULs) and sets *length.
+ * The file is read into a scratch buffer and only what it held is copied,
+ * as the results are kept (process details are only read from the main
+ * thread).
+ */
+static gchar *read_proc_file(pid_t pid, const char *name, gsize *length)
+{
+	static gchar scratch[PROC_FILE_MAX];
+	char path[64];
+	gchar *buffer;
+	gsize size = 0;
+	int fd;
+
+	snprintf(path, sizeof(path), "/proc/%lu/%s", (unsigned long)pid, name);
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+		return NULL;
+
+	while (size < PROC_FILE_MAX) {
+		ssize_t bytes = read(fd, scratch + size, PROC_FILE_MAX - size);
+		if (bytes < 0 && errno == EINTR)
+			continue;
+		if (bytes <= 0)
+			break;
+		size += bytes;
+	}
+	close(fd);
+
+	buffer = g_malloc(size + 1);
+	memcpy(buffer, scratch, size);
+	buffer[size] = 0;
+	if (length)
+		*length = size;
+	return buffer;
+}
+
+
+static gchar *read_proc_line(pid_t pid, const char *name)
+{
+	gchar *text = read_proc_file(pid, name, NULL);
+
+	if (text)
+		g_strchomp(text);
+	return text;
+}
+
+
+static gchar **read_proc_argv(pid_t pid)
+{
+	gsize length;
+	gchar *text = read_proc_file(pid, "cmdline", &length);
+	GPtrArray *args;
+	gsize i = 0;
+
+	if (!text)
+		return NULL;
+
+	// NUL-separated, usually with a trailing NUL
+	args = g_ptr_array_new();
+	while (i < length) {
+		g_ptr_array_add(args, g_strdup(text + i));
+		i += strlen(text + i) + 1;
+	}
+	g_ptr_array_add(args, NULL);
+
+	g_free(text);
+	return (gchar **)g_ptr_array_free(args, FALSE);
+}
+
+
+static pid_t read_proc_ppid(pid_t pid)
+{
+	gchar *text = read_proc_file(pid, "stat", NULL);
+	unsigned long ppid = 0;
+	char *p;
+
+	if (!text)
+		return 0;
+
+	// "pid (comm) state ppid ..."; comm may contain anything
+	p = strrchr(text, ')');
+	if (!p || sscanf(p + 1, " %*c %lu", &ppid) != 1)
+		ppid = 0;
+
+	g_free(text);
+	return ppid;
+}
+
+
+static gchar *read_proc_exe(pid_t pid)
+{
+	char path[64], target[PATH_MAX];
+	ssize_t length;
+
+	snprintf(path, sizeof(path), "/proc/%lu/exe", (unsigned long)pid);
+	length = readlink(path, target, sizeof(target) - 1);
+	if (length < 0)
+		return NULL;
+
+	target[length] = 0;
+	return g_strdup(target);
+}
+
+
+/**
+ * Look up a process, reading its details if they're not already known.
+ * Returns NULL if the process doesn't exist (or there's no /proc).
+ */
+const struct process_info *get_process_info(pid_t pid)
+{
+	struct process_info *info;
+
+	if (pid <= 0)
+		return NULL;
+
+	if (!process_cache)
+		process_cache = g_hash_table_new_full(NULL, NULL, NULL, free_process_info);
+
+	info = g_hash_table_lookup(process_cache, GINT_TO_POINTER(pid));
+	if (info)
+		return info;
+
+	info = g_new0(struct process_info, 1);
+	info->pid = pid;
+	info->comm = read_proc_line(pid, "comm");
+	if (!info->comm) {
+		// gone, or no /proc; don't cache this
+		g_free(info);
+		return NULL;
+	}
+	info->ppid = read_proc_ppid(pid);
+	info->exe = read_proc_exe(pid);
+	info->argv = read_proc_argv(pid);
+	info->cgroup = read_proc_line(pid, "cgroup");
+
+	g_hash_table_insert(process_cache, GINT_TO_POINTER(pid), info);
+	return info;
+}
+
+
+/**
+ * Forget about a process; called when one of its windows is closed, as the
+ * pid may be reused.
+ */
+void process_info_forget(pid_t pid)
+{
+	if (process_cache)
+		g_hash_table_remove(process_cache, GINT_TO_POINTER(pid));
+}
@@ -0,0 +1,41 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __HEADER_PROCESS_INFO_
+#define __HEADER_PROCESS_INFO_
+
+#include <sys/types.h>
+#include <glib.h>
+
+/**
+ * Process details, read from /proc. Any field may be NULL (or 0) if it
+ * couldn't be read.
+ */
+struct process_info {
+	pid_t pid;
+	pid_t ppid;
+	gchar *comm;	// process name
+	gchar *exe;	// executable path
+	gchar **argv;	// command line
+	gchar *cgroup;
+};
+
+const struct process_info *get_process_info(pid_t pid);
+void process_info_forget(pid_t pid);
+
+#endif /*__HEADER_PROCESS_INFO_*/
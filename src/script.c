@@ -32,9 +32,13 @@
 
 #include <locale.h>
 
+#include "batch.h"
 #include "compat.h"
+#include "config.h"
 #include "intl.h"
 #include "script.h"
+#include "script_cache.h"
+#include "stats.h"
 #include "logger.h"
 
 #if (GTK_MAJOR_VERSION >= 3)
@@ -42,8 +46,15 @@
 #endif
 
 #include "script_functions.h"
+#include "script_window.h"
 
 
+#define SCRIPT_TIMEOUT_SECONDS 5
+
+#ifndef _DEBUG
+#define SCRIPT_TIMEOUT_COUNT 1000
+static void check_timeout_script(lua_State *lua, lua_Debug *state);
+#endif
 
 /**
  *
@@ -88,6 +99,10 @@ init_script(gchar * script_folder)
 
 	configureLuaPaths(lua, script_folder);
 
+#ifndef _DEBUG
+	lua_sethook(lua, check_timeout_script, LUA_MASKCOUNT, SCRIPT_TIMEOUT_COUNT);
+#endif
+
 	return lua;
 }
 
@@ -190,6 +205,7 @@ register_cfunctions(lua_State *lua)
 	DP2_REGISTER(lua, get_window_property);
 	DP2_REGISTER(lua, window_property_is_utf8);
 	DP2_REGISTER(lua, get_window_property_full);
+	DP2_REGISTER(lua, get_window_property_data);
 	DP2_REGISTER(lua, get_window_role);
 	DP2_REGISTER(lua, get_window_xid);
 
@@ -231,8 +247,16 @@ register_cfunctions(lua_State *lua)
 	DP2_REGISTER(lua, on_geometry_changed);
 
 	DP2_REGISTER(lua, get_process_name);
+	DP2_REGISTER(lua, get_process_info);
 
 	DP2_REGISTER(lua, millisleep);
+	DP2_REGISTER(lua, after);
+
+	register_window_type(lua);
+	DP2_REGISTER(lua, get_windows);
+	DP2_REGISTER(lua, get_active_window);
+	DP2_REGISTER(lua, get_current_window);
+	DP2_REGISTER(lua, find_windows);
 }
 
 
@@ -285,17 +309,18 @@ static ATTR_MALLOC gchar *error_add_location(lua_State* lua, const char *msg)
 	return g_strdup_printf("%s:%d: %s", state.short_src, state.currentline, msg);
 }
 
-static gboolean timedout = FALSE;
-
-static void timeout_script(int sig)
-{
-	timedout = TRUE;
-}
+/**
+ * Script time-out.
+ * The hook is installed once per Lua state (by init_script) and runs every
+ * SCRIPT_TIMEOUT_COUNT instructions; it only needs to compare the clock
+ * against the deadline set by run_script (0 when no script is running).
+ */
+static gint64 script_deadline = 0;
 
 static void check_timeout_script(lua_State *lua, lua_Debug *state)
 {
 	// state is invalid?
-	if (!timedout)
+	if (!script_deadline || g_get_monotonic_time() < script_deadline)
 		return;
 	// don't add backtrace etc. here; just the location
 	gchar *msg = error_add_location(lua, _("script timed out"));
@@ -317,22 +342,280 @@ static int script_error(lua_State *lua)
 }
 
 
+/**
+ * Scripts run by the daemon are run as coroutines, so that millisleep()
+ * can yield to the main loop rather than block it; they're resumed from a
+ * timeout. after() uses the same mechanism to run a function later.
+ */
+struct script_thread {
+	lua_State *lua;		// the main state
+	lua_State *thread;
+	int ref;		// keeps the thread alive
+	WnckWindow *window;	// the window which the script is working on
+	gchar *filename;	// NULL for functions
+	gint64 load_time, run_time;
+	guint sleep;		// ms, set before yielding
+	gboolean asleep;	// yielded through script_sleep()
+	guint source;		// pending resumption
+};
+
+// thread -> struct script_thread
+static GHashTable *script_threads = NULL;
+
+
+static int resume(lua_State *thread, int nargs)
+{
+#if LUA_VERSION_NUM >= 504
+	int nresults;
+	return lua_resume(thread, NULL, nargs, &nresults);
+#elif LUA_VERSION_NUM >= 502
+	return lua_resume(thread, NULL, nargs);
+#else
+	return lua_resume(thread, nargs);
+#endif
+}
+
+
+static void finish_thread(struct script_thread *st)
+{
+	g_hash_table_remove(script_threads, st->thread);
+	if (st->source)
+		g_source_remove(st->source);
+	luaL_unref(st->lua, LUA_REGISTRYINDEX, st->ref);
+	g_free(st->filename);
+	g_free(st);
+}
+
+
+/**
+ * Drop every thread for which match() returns TRUE.
+ */
+static void finish_threads(gboolean (*match)(const struct script_thread *, gconstpointer), gconstpointer data)
+{
+	GHashTableIter iter;
+	gpointer value;
+	GSList *doomed = NULL, *item;
+
+	if (!script_threads)
+		return;
+
+	g_hash_table_iter_init(&iter, script_threads);
+	while (g_hash_table_iter_next(&iter, NULL, &value))
+		if (match(value, data))
+			doomed = g_slist_prepend(doomed, value);
+
+	for (item = doomed; item; item = item->next)
+		finish_thread(item->data);
+	g_slist_free(doomed);
+}
+
+
+static gboolean thread_has_window(const struct script_thread *st, gconstpointer window)
+{
+	return st->window == window;
+}
+
+
+static gboolean thread_has_state(const struct script_thread *st, gconstpointer lua)
+{
+	return st->lua == lua;
+}
+
+
+static gboolean resume_cb(gpointer data);
+
+static void resume_thread(struct script_thread *st)
+{
+	WnckWindow *old_window = get_current_window();
+	gint64 start = g_get_monotonic_time();
+
+	set_current_window(st->window);
+	// window changes made by the script are sent together when it stops
+	batch_begin();
+#ifndef _DEBUG
+	script_deadline = start + SCRIPT_TIMEOUT_SECONDS * G_USEC_PER_SEC;
+#endif
+	int status = resume(st->thread, 0);
+#ifndef _DEBUG
+	script_deadline = 0;
+#endif
+	batch_end();
+	st->run_time += g_get_monotonic_time() - start;
+	set_current_window(old_window);
+
+	if (status == LUA_YIELD && st->asleep) {
+		lua_settop(st->thread, 0);
+		st->source = g_timeout_add(st->sleep, resume_cb, st);
+		st->sleep = 0;
+		st->asleep = FALSE;
+		return;
+	}
+
+	if (status == LUA_YIELD) {
+		/*
+		 * A bare coroutine.yield(): there's nothing to wait for, and
+		 * resuming it straight away, again and again, would keep the
+		 * main loop from handling X events.
+		 */
+		gchar *fullmsg = error_add_backtrace(st->thread,
+		                                     _("coroutine.yield() outside a coroutine; use millisleep() to wait"));
+		logger_err_printf(_("Error: %s\n"), fullmsg);
+		g_free(fullmsg);
+	} else if (status) {
+		const char *msg = lua_tostring(st->thread, -1);
+		// the dead thread's stack is still there to be traced
+		gchar *fullmsg = error_add_backtrace(st->thread, msg ? msg : _("(no error message)"));
+		logger_err_printf(_("Error: %s\n"), fullmsg);
+		g_free(fullmsg);
+	}
+
+	if (st->filename)
+		stats_record_script(st->filename, st->load_time, st->run_time);
+	finish_thread(st);
+}
+
+
+static gboolean resume_cb(gpointer data)
+{
+	struct script_thread *st = data;
+
+	st->source = 0;
+	resume_thread(st);
+	return FALSE;
+}
+
+
+/**
+ * Run the function at the top of the stack in a new coroutine, working on
+ * window. The function is popped.
+ */
+static void start_thread(lua_State *lua, WnckWindow *window, const char *filename,
+                         gint64 load_time, guint delay)
+{
+	struct script_thread *st = g_new0(struct script_thread, 1);
+
+	st->lua = script_main_state(lua);
+	st->thread = lua_newthread(lua);
+	lua_insert(lua, -2);
+	lua_xmove(lua, st->thread, 1);
+	st->ref = luaL_ref(lua, LUA_REGISTRYINDEX);
+	st->window = window;
+	st->filename = g_strdup(filename);
+	st->load_time = load_time;
+
+	if (!script_threads)
+		script_threads = g_hash_table_new(NULL, NULL);
+	g_hash_table_insert(script_threads, st->thread, st);
+
+	if (delay)
+		st->source = g_timeout_add(delay, resume_cb, st);
+	else
+		resume_thread(st);
+}
+
+
+/**
+ * Run the function at the top of the stack (popping it) as if it were a
+ * script, working on window, after delay ms (or now, if 0).
+ */
+void run_function(lua_State *lua, WnckWindow *window, guint delay)
+{
+	start_thread(lua, window, NULL, 0, delay);
+}
+
+
+/**
+ * Is lua one of our script coroutines, and can it yield here?
+ * (Lua 5.2 can't tell us whether there's a C call in the way.)
+ */
+gboolean script_can_yield(lua_State *lua)
+{
+#if LUA_VERSION_NUM >= 503
+	return script_threads && g_hash_table_contains(script_threads, lua) &&
+	       lua_isyieldable(lua);
+#else
+	return FALSE;
+#endif
+}
+
+
+/**
+ * Yield from a C function, to be resumed after ms milliseconds.
+ * Check script_can_yield first. Use as "return script_sleep(lua, ms);".
+ */
+int script_sleep(lua_State *lua, guint ms)
+{
+	struct script_thread *st = g_hash_table_lookup(script_threads, lua);
+
+	st->sleep = ms;
+	st->asleep = TRUE;
+	return lua_yield(lua, 0);
+}
+
+
+/**
+ * Drop any sleeping scripts and pending functions for a window which has
+ * been closed.
+ */
+void script_forget_window(WnckWindow *window)
+{
+	finish_threads(thread_has_window, window);
+}
+
+
+/**
+ * Find the main thread; callbacks must not be tied to a coroutine.
+ */
+lua_State *script_main_state(lua_State *lua)
+{
+#if LUA_VERSION_NUM >= 502
+	lua_State *main_state;
+
+	lua_rawgeti(lua, LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
+	main_state = lua_tothread(lua, -1);
+	lua_pop(lua, 1);
+	return main_state;
+#else
+	struct script_thread *st = script_threads ? g_hash_table_lookup(script_threads, lua) : NULL;
+	return st ? st->lua : lua;
+#endif
+}
+
+
 /**
  *
  */
 int
 run_script(lua_State *lua, const char *filename)
 {
-#define SCRIPT_TIMEOUT_SECONDS 5
-
 	if (!lua)
 		return -1;
 
+	if (lua == global_lua_state) {
+		// the daemon's own state keeps compiled chunks between events
+		gint64 start = g_get_monotonic_time();
+		int result = script_cache_load(lua, filename);
+
+		if (result) {
+			// We got an error, print it
+			logger_err_printf(_("Error: %s\n"), lua_tostring(lua, -1));
+			lua_pop(lua, 1);
+			return -1;
+		}
+
+		start_thread(lua, get_current_window(), filename, g_get_monotonic_time() - start, 0);
+		return 0;
+	}
+
 	lua_pushcfunction(lua, script_error);
 	int errpos = lua_gettop(lua);
 
+	gint64 start = g_get_monotonic_time();
+
 	int result = luaL_loadfile(lua, filename);
 
+	gint64 loaded = g_get_monotonic_time();
+
 	if (result) {
 		// We got an error, print it
 		logger_err_printf(_("Error: %s\n"), lua_tostring(lua, -1));
@@ -343,21 +626,13 @@ run_script(lua_State *lua, const char *filename)
 
 	// Okay, loaded the script; now run it
 #ifndef _DEBUG
-	struct sigaction newact, oldact;
-	newact.sa_handler = timeout_script;
-	sigemptyset(&newact.sa_mask);
-	newact.sa_flags = 0;
-
-	timedout = FALSE;
-	lua_sethook(lua, check_timeout_script, LUA_MASKCOUNT, 1);
-	sigaction(SIGALRM, &newact, &oldact);
-	alarm(SCRIPT_TIMEOUT_SECONDS);
+	script_deadline = g_get_monotonic_time() + SCRIPT_TIMEOUT_SECONDS * G_USEC_PER_SEC;
 #endif
 	int s = lua_pcall(lua, 0, LUA_MULTRET, errpos);
 #ifndef _DEBUG
-	alarm(0);
-	sigaction(SIGALRM, &oldact, NULL);
+	script_deadline = 0;
 #endif
+	stats_record_script(filename, loaded - start, g_get_monotonic_time() - loaded);
 	lua_remove(lua, errpos); // unstack the error handler
 
 	if (s) {
@@ -366,16 +641,199 @@ run_script(lua_State *lua, const char *filename)
 		lua_pop(lua, 1); // else we leak it
 	}
 
+	// discard anything returned by the script
+	lua_settop(lua, errpos - 1);
+
 	return 0;
 }
 
 
+/**
+ * Handler scripts are run once, in an environment of their own, to define
+ * their handler functions; again whenever they are recompiled. That run is
+ * of a copy of the compiled chunk, so that the cached chunk, which
+ * run_script() uses, is left working in the globals.
+ */
+struct handler_env {
+	int chunk;	// the cached chunk, a copy of which was run to set it up
+	int env;
+	int handlers;	// where its functions are: the table it returned, else env
+};
+
+// file name -> struct handler_env, in global_lua_state
+static GHashTable *handler_envs = NULL;
+
+
+/**
+ * Run a copy of the handler script's chunk, at the top of the stack (and
+ * popped), to set up its environment. It works on the current window, as
+ * it would if it were run as a plain script for the event.
+ */
+static struct handler_env *setup_handler(lua_State *lua, const char *filename)
+{
+	struct handler_env *he;
+
+	if (!handler_envs)
+		handler_envs = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+	he = g_hash_table_lookup(handler_envs, filename);
+	if (he) {
+		luaL_unref(lua, LUA_REGISTRYINDEX, he->chunk);
+		luaL_unref(lua, LUA_REGISTRYINDEX, he->env);
+		luaL_unref(lua, LUA_REGISTRYINDEX, he->handlers);
+	} else {
+		he = g_new(struct handler_env, 1);
+		g_hash_table_insert(handler_envs, g_strdup(filename), he);
+	}
+
+	lua_pushvalue(lua, -1);
+	he->chunk = luaL_ref(lua, LUA_REGISTRYINDEX);
+
+	// anything not defined by the script is looked up in the globals
+	lua_newtable(lua);
+	lua_newtable(lua);
+#if LUA_VERSION_NUM >= 502
+	lua_pushglobaltable(lua);
+#else
+	lua_pushvalue(lua, LUA_GLOBALSINDEX);
+#endif
+	lua_setfield(lua, -2, "__index");
+	lua_setmetatable(lua, -2);
+	he->env = luaL_ref(lua, LUA_REGISTRYINDEX);
+
+	if (script_cache_copy_chunk(lua, filename)) {
+		logger_err_printf(_("Error: %s\n"), lua_tostring(lua, -1));
+		lua_pop(lua, 1);
+		lua_rawgeti(lua, LUA_REGISTRYINDEX, he->env);
+		he->handlers = luaL_ref(lua, LUA_REGISTRYINDEX);
+		return he;
+	}
+
+	lua_rawgeti(lua, LUA_REGISTRYINDEX, he->env);
+#if LUA_VERSION_NUM >= 502
+	lua_setupvalue(lua, -2, 1); // _ENV
+#else
+	lua_setfenv(lua, -2);
+#endif
+
+	lua_pushcfunction(lua, script_error);
+	lua_insert(lua, -2);
+	int errpos = lua_gettop(lua) - 1;
+	batch_begin();
+#ifndef _DEBUG
+	script_deadline = g_get_monotonic_time() + SCRIPT_TIMEOUT_SECONDS * G_USEC_PER_SEC;
+#endif
+	if (lua_pcall(lua, 0, 1, errpos)) {
+		logger_err_printf(_("Error: %s\n"), lua_tostring(lua, -1));
+		lua_pop(lua, 1);
+		lua_pushnil(lua);
+	}
+#ifndef _DEBUG
+	script_deadline = 0;
+#endif
+	batch_end();
+	// a script may also return a table of its functions, module-style
+	if (!lua_istable(lua, -1)) {
+		lua_pop(lua, 1);
+		lua_rawgeti(lua, LUA_REGISTRYINDEX, he->env);
+	}
+	he->handlers = luaL_ref(lua, LUA_REGISTRYINDEX);
+	lua_pop(lua, 1); // the error handler
+
+	return he;
+}
+
+
+/**
+ * Whether the table at the top of the stack has any handler functions.
+ * Only its own fields count, not globals seen through its metatable.
+ */
+static gboolean has_handler_functions(lua_State *lua)
+{
+	gboolean found = FALSE;
+	int i;
+
+	for (i = 0; i < W_NUM_EVENTS && !found; i++) {
+		lua_pushstring(lua, handler_names[i]);
+		lua_rawget(lua, -2);
+		found = lua_isfunction(lua, -1);
+		lua_pop(lua, 1);
+	}
+
+	return found;
+}
+
+
+/**
+ * Call a handler script's function for an event, if it has one. The
+ * script is first run, once, to define its functions; what it has defined
+ * is then looked at afresh for each event, so handlers may also be set up
+ * while it runs. If it has just been run for that, and has no function for
+ * this event, that run stands in for running it as a whole.
+ */
+handler_result run_handler(lua_State *lua, const char *filename, const char *handler)
+{
+	gint64 start = g_get_monotonic_time();
+	struct handler_env *he;
+	gboolean set_up = FALSE;
+
+	if (script_cache_load(lua, filename)) {
+		logger_err_printf(_("Error: %s\n"), lua_tostring(lua, -1));
+		lua_pop(lua, 1);
+		return HANDLER_FAILED;
+	}
+
+	he = handler_envs ? g_hash_table_lookup(handler_envs, filename) : NULL;
+	if (he) {
+		lua_rawgeti(lua, LUA_REGISTRYINDEX, he->chunk);
+		if (!lua_rawequal(lua, -1, -2))
+			he = NULL; // recompiled since
+		lua_pop(lua, 1);
+	}
+	if (he) {
+		lua_pop(lua, 1);
+	} else {
+		he = setup_handler(lua, filename);
+		set_up = TRUE;
+	}
+
+	lua_rawgeti(lua, LUA_REGISTRYINDEX, he->handlers);
+	lua_pushstring(lua, handler);
+	lua_rawget(lua, -2);
+
+	if (!lua_isfunction(lua, -1)) {
+		handler_result result;
+
+		lua_pop(lua, 1);
+		if (set_up)
+			result = HANDLER_SET_UP;
+		else
+			result = has_handler_functions(lua) ? HANDLER_NOT_DEFINED : HANDLER_NONE;
+		lua_pop(lua, 1);
+		return result;
+	}
+	lua_remove(lua, -2);
+
+	start_thread(lua, get_current_window(), filename, g_get_monotonic_time() - start, 0);
+	return HANDLER_CALLED;
+}
+
+
 /**
  *
  */
 void
 done_script(lua_State *lua)
 {
+	if (lua)
+		finish_threads(thread_has_state, lua);
+	if (lua && lua == global_lua_state) {
+		script_cache_clear();
+		if (handler_envs) {
+			g_hash_table_destroy(handler_envs);
+			handler_envs = NULL;
+		}
+	}
 	if (lua)
 		lua_close(lua);
 
@@ -389,29 +847,31 @@ lua_State * reinit_script(lua_State *lua, gchar * script_folder)
 }
 
 /**
- * Given a module name, ask lua if it is a loaded module in the given Lua VM
+ * Forget a loaded module, so that the next require() of it loads it afresh.
+ * Returns TRUE if it had been loaded.
  */
-gboolean is_module_loaded(lua_State * lua, const gchar * module_name)
+gboolean unload_module(lua_State *lua, const gchar *module_name)
 {
-	if( lua == NULL ) return FALSE;
-
-	const char PACKAGE_CMD[] = "return package.loaded['%s']";
-
-	gulong maxlen = strlen(module_name) + sizeof(PACKAGE_CMD);
-	gchar buff[maxlen];
-	if ( maxlen >= g_snprintf(buff, maxlen, PACKAGE_CMD, module_name) )
-	{
-		if ( luaL_dostring(lua, buff ) ) {
-			return FALSE;  // Couldn't even call into Lua, something is wrong, just let things fail elsewhere
+	gboolean loaded = FALSE;
+
+	if (lua == NULL) return FALSE;
+
+	lua_getglobal(lua, "package");
+	if (lua_istable(lua, -1)) {
+		lua_getfield(lua, -1, "loaded");
+		if (lua_istable(lua, -1)) {
+			lua_getfield(lua, -1, module_name);
+			loaded = lua_toboolean(lua, -1);
+			lua_pop(lua, 1);
+
+			if (loaded) {
+				lua_pushnil(lua);
+				lua_setfield(lua, -2, module_name);
+			}
 		}
-
-		if( lua_istable(lua, -1) )  // Loaded modules will normally be a table
-		{
-			lua_pop(lua, -1);
-			return TRUE;
-		}
-		// But really simple modules that return nothing may just be a boolean value to indicate that they have been loaded
-		if( lua_isboolean(lua, -1) && lua_toboolean(lua, -1) == TRUE) return TRUE;
+		lua_pop(lua, 1);
 	}
-	return FALSE;
+	lua_pop(lua, 1);
+
+	return loaded;
 }
@@ -21,6 +21,8 @@
 
 #include <lua.h>
 #include <glib.h>
+#define WNCK_I_KNOW_THIS_IS_UNSTABLE
+#include <libwnck/libwnck.h>
 
 /**
  *
@@ -35,9 +37,25 @@ void configureLuaPaths(lua_State *lua, gchar * script_folder);
 
 void register_cfunctions(lua_State *lua);
 int run_script(lua_State *lua, const char *filename);
+
+typedef enum {
+	HANDLER_CALLED,
+	HANDLER_NOT_DEFINED,	/* it has handler functions, but not this one */
+	HANDLER_NONE,	/* it has no handler functions: run it as a plain script */
+	HANDLER_SET_UP,	/* it was just run as a whole to set it up, and has no function for this event */
+	HANDLER_FAILED
+} handler_result;
+
+handler_result run_handler(lua_State *lua, const char *filename, const char *handler);
 void done_script(lua_State *lua);
 lua_State * reinit_script(lua_State *lua, gchar * script_folder);
-gboolean is_module_loaded(lua_State * lua, const gchar * module_name);
+gboolean unload_module(lua_State *lua, const gchar *module_name);
+
+void run_function(lua_State *lua, WnckWindow *window, guint delay);
+gboolean script_can_yield(lua_State *lua);
+int script_sleep(lua_State *lua, guint ms);
+void script_forget_window(WnckWindow *window);
+lua_State *script_main_state(lua_State *lua);
 
 
 extern gboolean devilspie2_debug;
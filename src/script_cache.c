@@ -0,0 +1,593 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <string.h>
+
+#include <glib.h>
+#include <glib/gstdio.h>
+
+#include <lua.h>
+#include <lauxlib.h>
+
+#include "script_cache.h"
+#include "logger.h"
+
+// binary chunks can be loaded via luaL_loadbufferx from Lua 5.2 onwards
+#if LUA_VERSION_NUM >= 502
+#define HAVE_DISK_CACHE
+#endif
+
+#if LUA_VERSION_NUM >= 503
+#define dp2_lua_dump(L, writer, data) lua_dump(L, writer, data, 0)
+#else
+#define dp2_lua_dump(L, writer, data) lua_dump(L, writer, data)
+#endif
+
+#define DISK_CACHE_MAGIC "DP2C1"
+
+
+/**
+ *
+ */
+struct script_chunk {
+	int ref;	// compiled function, in the registry of cache_lua
+	dev_t dev;
+	ino_t ino;
+	gint64 mtime;	// nanoseconds
+	off_t size;
+};
+
+static GHashTable *chunk_cache = NULL;
+static lua_State *cache_lua = NULL;
+
+static gchar *disk_cache_folder = NULL;
+static gboolean disk_cache_rebuild = FALSE;
+
+static guint stat_compiled = 0, stat_from_disk = 0;
+
+
+/**
+ * Cache keys are canonical paths so that names from the config file and
+ * names reported by the directory monitor refer to the same entry.
+ */
+static gchar *chunk_key(const char *filename)
+{
+	return g_canonicalize_filename(filename, NULL);
+}
+
+
+static gboolean chunk_stat(const char *filename, struct script_chunk *chunk)
+{
+	GStatBuf st;
+
+	if (g_stat(filename, &st) != 0)
+		return FALSE;
+
+	chunk->dev = st.st_dev;
+	chunk->ino = st.st_ino;
+	chunk->mtime = (gint64)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+	chunk->size = st.st_size;
+	return TRUE;
+}
+
+
+static void chunk_free(gpointer data)
+{
+	struct script_chunk *chunk = data;
+
+	// the registry entry goes away with the Lua state; only drop it if
+	// the state is still alive
+	if (cache_lua && chunk->ref != LUA_NOREF)
+		luaL_unref(cache_lua, LUA_REGISTRYINDEX, chunk->ref);
+	g_free(chunk);
+}
+
+
+static int chunk_writer(lua_State *lua G_GNUC_UNUSED, const void *p, size_t sz, void *ud)
+{
+	g_string_append_len((GString *)ud, p, sz);
+	return 0;
+}
+
+
+#ifdef HAVE_DISK_CACHE
+/**
+ * The on-disk cache holds one file per script, named after a hash of the
+ * script's path. Each starts with a header line giving the Lua release and
+ * a hash of the source; anything which doesn't match is recompiled.
+ */
+static gchar *disk_cache_header(const gchar *source_hash)
+{
+	return g_strdup_printf("%s %s %s\n", DISK_CACHE_MAGIC, LUA_RELEASE, source_hash);
+}
+
+
+static gchar *disk_cache_filename(const gchar *key)
+{
+	gchar *hash = g_compute_checksum_for_string(G_CHECKSUM_SHA256, key, -1);
+	gchar *name = g_strconcat(hash, ".luac", NULL);
+	gchar *path = g_build_filename(disk_cache_folder, name, NULL);
+
+	g_free(name);
+	g_free(hash);
+	return path;
+}
+
+
+/**
+ * Produce the binary chunk for filename: from the on-disk cache if it's
+ * enabled and up to date, else by compiling the source in a Lua state of
+ * its own (refreshing the on-disk cache). This touches no shared state, so
+ * that it can be run by the compile workers.
+ * Returns NULL on failure, with the error message in *error.
+ */
+static GString *chunk_build(const char *filename, const gchar *key,
+                            gboolean *from_disk, gchar **error)
+{
+	gchar *source = NULL;
+	gsize length = 0, skip = 0;
+	GString *chunk = NULL;
+
+	*from_disk = FALSE;
+	*error = NULL;
+
+	if (!g_file_get_contents(filename, &source, &length, NULL)) {
+		*error = g_strdup_printf("cannot read %s", filename);
+		return NULL;
+	}
+
+	gchar *source_hash = g_compute_checksum_for_data(G_CHECKSUM_SHA256, (guchar *)source, length);
+	gchar *header = disk_cache_header(source_hash);
+	gsize header_len = strlen(header);
+	gchar *cache_file = disk_cache_folder ? disk_cache_filename(key) : NULL;
+	gchar *cached = NULL;
+	gsize cached_len = 0;
+
+	if (cache_file && !disk_cache_rebuild &&
+	    g_file_get_contents(cache_file, &cached, &cached_len, NULL) &&
+	    cached_len > header_len && !memcmp(cached, header, header_len)) {
+		chunk = g_string_new_len(cached + header_len, cached_len - header_len);
+		*from_disk = TRUE;
+	}
+	g_free(cached);
+
+	if (!chunk) {
+		lua_State *lua = luaL_newstate();
+		gchar *chunkname = g_strconcat("@", filename, NULL);
+
+		// as luaL_loadfile: skip a UTF-8 BOM and a '#' first line (but
+		// not its line break, so that line numbers are unaffected)
+		if (length >= 3 && !memcmp(source, "\xEF\xBB\xBF", 3))
+			skip = 3;
+		if (skip < length && source[skip] == '#')
+			while (skip < length && source[skip] != '\n')
+				++skip;
+
+		if (luaL_loadbuffer(lua, source + skip, length - skip, chunkname) != 0) {
+			*error = g_strdup(lua_tostring(lua, -1));
+		} else {
+			chunk = g_string_new(NULL);
+			dp2_lua_dump(lua, chunk_writer, chunk);
+
+			if (cache_file) {
+				GString *contents = g_string_new(header);
+				g_string_append_len(contents, chunk->str, chunk->len);
+				if (!g_file_set_contents(cache_file, contents->str, contents->len, NULL))
+					*error = g_strdup_printf("Couldn't write script cache file %s", cache_file);
+				g_string_free(contents, TRUE);
+			}
+		}
+
+		g_free(chunkname);
+		lua_close(lua);
+	}
+
+	g_free(cache_file);
+	g_free(header);
+	g_free(source_hash);
+	g_free(source);
+	return chunk;
+}
+
+
+/**
+ * Push the binary chunk, as from chunk_build(), as a function.
+ * Returns as for luaL_loadfile.
+ */
+static int chunk_push(lua_State *lua, const char *filename, GString *chunk)
+{
+	gchar *chunkname = g_strconcat("@", filename, NULL);
+	int result = luaL_loadbufferx(lua, chunk->str, chunk->len, chunkname, "b");
+
+	g_free(chunkname);
+	return result;
+}
+
+
+/**
+ * Load the script from the on-disk cache if possible, else compile it and
+ * refresh the cache. Returns -1 if the caller should fall back on
+ * luaL_loadfile, else as for luaL_loadfile.
+ */
+static int disk_cache_load(lua_State *lua, const char *filename, const gchar *key)
+{
+	gboolean from_disk;
+	gchar *error;
+	GString *chunk = chunk_build(filename, key, &from_disk, &error);
+	int result = -1;
+
+	if (chunk) {
+		if (error) // written to the on-disk cache
+			logger_err_printf("%s\n", error);
+		result = chunk_push(lua, filename, chunk);
+		if (result != 0)
+			lua_pop(lua, 1);
+		else if (from_disk)
+			++stat_from_disk;
+		else
+			++stat_compiled;
+		g_string_free(chunk, TRUE);
+	}
+	g_free(error);
+
+	return result;
+}
+#endif
+
+
+/**
+ * Enable the on-disk cache in $XDG_CACHE_HOME/devilspie2.
+ * If rebuild is set, existing cache files are ignored and overwritten.
+ */
+void script_cache_enable_disk(gboolean rebuild)
+{
+#ifdef HAVE_DISK_CACHE
+	g_free(disk_cache_folder);
+	disk_cache_folder = g_build_filename(g_get_user_cache_dir(), "devilspie2", NULL);
+	if (g_mkdir_with_parents(disk_cache_folder, 0700) != 0) {
+		logger_err_printf("Couldn't create script cache folder %s\n", disk_cache_folder);
+		g_free(disk_cache_folder);
+		disk_cache_folder = NULL;
+	}
+	disk_cache_rebuild = rebuild;
+#endif
+}
+
+
+/**
+ * The scripts have been compiled afresh once; from now on, cache files
+ * are used again (those just written, or those of scripts changed since).
+ */
+void script_cache_rebuild_done(void)
+{
+	disk_cache_rebuild = FALSE;
+}
+
+
+/**
+ * Report (and reset) how many scripts were compiled from source and how
+ * many were read from the on-disk cache.
+ */
+void script_cache_get_stats(guint *compiled, guint *from_disk)
+{
+	*compiled = stat_compiled;
+	*from_disk = stat_from_disk;
+	stat_compiled = stat_from_disk = 0;
+}
+
+
+static void cache_init(lua_State *lua)
+{
+	if (cache_lua != lua) {
+		script_cache_clear();
+		cache_lua = lua;
+	}
+	if (!chunk_cache)
+		chunk_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, chunk_free);
+}
+
+
+static gboolean chunk_is_current(const struct script_chunk *chunk, const struct script_chunk *now)
+{
+	return now->dev == chunk->dev && now->ino == chunk->ino &&
+	       now->mtime == chunk->mtime && now->size == chunk->size;
+}
+
+
+/**
+ * Compile filename and push the result, or the error message; with meta,
+ * which describes the file, the result is also stored under key (which is
+ * then owned by the cache).
+ */
+static int chunk_compile(lua_State *lua, const char *filename, gchar *key,
+                         const struct script_chunk *meta)
+{
+	struct script_chunk *chunk;
+	int result = -1;
+
+#ifdef HAVE_DISK_CACHE
+	if (disk_cache_folder && meta)
+		result = disk_cache_load(lua, filename, key);
+#endif
+	if (result < 0) {
+		result = luaL_loadfile(lua, filename);
+		if (result == 0)
+			++stat_compiled;
+	}
+	if (result || !meta) {
+		// don't cache failures; the file may be fixed or created later
+		g_free(key);
+		return result;
+	}
+
+	chunk = g_new(struct script_chunk, 1);
+	*chunk = *meta;
+	lua_pushvalue(lua, -1);
+	chunk->ref = luaL_ref(lua, LUA_REGISTRYINDEX);
+	g_hash_table_replace(chunk_cache, key, chunk);
+
+	return 0;
+}
+
+
+/**
+ * Push the compiled chunk for filename, compiling it if necessary.
+ * Returns 0 on success or the luaL_loadfile error code, in which case the
+ * error message is pushed instead.
+ */
+int script_cache_load(lua_State *lua, const char *filename)
+{
+	cache_init(lua);
+
+	gchar *key = chunk_key(filename);
+	struct script_chunk *chunk = g_hash_table_lookup(chunk_cache, key);
+
+	if (chunk) {
+		g_free(key);
+		lua_rawgeti(lua, LUA_REGISTRYINDEX, chunk->ref);
+		return 0;
+	}
+
+	struct script_chunk meta;
+	gboolean have_meta = chunk_stat(filename, &meta);
+
+	return chunk_compile(lua, filename, key, have_meta ? &meta : NULL);
+}
+
+
+/**
+ * Replace the compiled chunk at the top of the stack (as pushed by
+ * script_cache_load()) with a copy which has upvalues, and so an
+ * environment, of its own. Returns as for luaL_loadbuffer, with the error
+ * message replacing the chunk on failure.
+ */
+int script_cache_copy_chunk(lua_State *lua, const char *filename)
+{
+	GString *chunk = g_string_new(NULL);
+	gchar *chunkname = g_strconcat("@", filename, NULL);
+	int result;
+
+	dp2_lua_dump(lua, chunk_writer, chunk);
+	lua_pop(lua, 1);
+	result = luaL_loadbuffer(lua, chunk->str, chunk->len, chunkname);
+
+	g_free(chunkname);
+	g_string_free(chunk, TRUE);
+	return result;
+}
+
+
+/**
+ * Recompile filename if it has changed since it was cached. Unlike
+ * invalidating and reloading, a file which doesn't compile (such as one
+ * which is only partly written) leaves the previous version in use.
+ * Returns 0 on success, else the luaL_loadfile error code with the error
+ * message pushed.
+ */
+int script_cache_refresh(lua_State *lua, const char *filename)
+{
+	cache_init(lua);
+
+	gchar *key = chunk_key(filename);
+	struct script_chunk *chunk = g_hash_table_lookup(chunk_cache, key);
+	struct script_chunk meta;
+	int result;
+
+	if (!chunk_stat(filename, &meta)) {
+		g_free(key);
+		lua_pushfstring(lua, "cannot open %s", filename);
+		return LUA_ERRFILE;
+	}
+
+	if (chunk && chunk_is_current(chunk, &meta)) {
+		g_free(key);
+		return 0;
+	}
+
+	result = chunk_compile(lua, filename, key, &meta);
+	if (result == 0)
+		lua_pop(lua, 1);
+	return result;
+}
+
+
+/**
+ * Forget the compiled chunk for filename unless the file is unchanged.
+ */
+void script_cache_invalidate(const char *filename)
+{
+	if (!chunk_cache)
+		return;
+
+	gchar *key = chunk_key(filename);
+	struct script_chunk *chunk = g_hash_table_lookup(chunk_cache, key);
+
+	if (chunk) {
+		struct script_chunk now;
+		if (!chunk_stat(filename, &now) || !chunk_is_current(chunk, &now))
+			g_hash_table_remove(chunk_cache, key);
+	}
+
+	g_free(key);
+}
+
+
+/**
+ * Forget everything; called when the Lua state is about to be closed.
+ */
+void script_cache_clear(void)
+{
+	cache_lua = NULL;
+	if (chunk_cache) {
+		g_hash_table_destroy(chunk_cache);
+		chunk_cache = NULL;
+	}
+}
+
+
+#ifdef HAVE_DISK_CACHE
+/**
+ * A script to be compiled by the worker pool
+ */
+struct compile_job {
+	const char *filename;
+	gchar *key;
+	struct script_chunk meta;
+	GString *chunk;	// NULL on failure
+	gboolean from_disk;
+	gchar *error;
+};
+
+
+static void compile_job_run(gpointer data, gpointer user_data G_GNUC_UNUSED)
+{
+	struct compile_job *job = data;
+
+	job->chunk = chunk_build(job->filename, job->key, &job->from_disk, &job->error);
+}
+#endif
+
+
+/**
+ * Bring the compiled chunks for all of the given files up to date, as
+ * script_cache_refresh() does for one. Compilation is spread over one
+ * worker thread per CPU, each with a Lua state of its own; only loading
+ * the resulting binary chunks is done in lua. Files which don't exist are
+ * skipped; for those which don't compile, the error is logged.
+ * Returns the number of files which didn't compile.
+ */
+guint script_cache_compile(lua_State *lua, GPtrArray *filenames)
+{
+	guint failed = 0;
+	guint i;
+
+	cache_init(lua);
+
+#ifdef HAVE_DISK_CACHE
+	GPtrArray *jobs = g_ptr_array_new();
+	GThreadPool *pool = NULL;
+
+	for (i = 0; i < filenames->len; i++) {
+		const char *filename = g_ptr_array_index(filenames, i);
+		struct compile_job *job = g_new0(struct compile_job, 1);
+		struct script_chunk *chunk;
+
+		job->filename = filename;
+		job->key = chunk_key(filename);
+		chunk = g_hash_table_lookup(chunk_cache, job->key);
+
+		if (!chunk_stat(filename, &job->meta) || (chunk && chunk_is_current(chunk, &job->meta))) {
+			g_free(job->key);
+			g_free(job);
+			continue;
+		}
+
+		g_ptr_array_add(jobs, job);
+	}
+
+	if (jobs->len > 1)
+		pool = g_thread_pool_new(compile_job_run, NULL,
+		                         MIN(g_get_num_processors(), jobs->len), FALSE, NULL);
+
+	for (i = 0; i < jobs->len; i++) {
+		if (pool)
+			g_thread_pool_push(pool, g_ptr_array_index(jobs, i), NULL);
+		else
+			compile_job_run(g_ptr_array_index(jobs, i), NULL);
+	}
+
+	if (pool)
+		g_thread_pool_free(pool, FALSE, TRUE);
+
+	// in order, so that any errors are reported in order
+	for (i = 0; i < jobs->len; i++) {
+		struct compile_job *job = g_ptr_array_index(jobs, i);
+
+		if (job->error)
+			logger_err_printf("%s\n", job->error);
+
+		if (!job->chunk) {
+			g_free(job->key);
+			++failed;
+		} else if (chunk_push(lua, job->filename, job->chunk) != 0) {
+			// not expected; fall back on compiling it here
+			lua_pop(lua, 1);
+			if (chunk_compile(lua, job->filename, job->key, &job->meta) == 0)
+				lua_pop(lua, 1);
+			else
+				++failed;
+		} else {
+			struct script_chunk *chunk = g_new(struct script_chunk, 1);
+
+			if (job->from_disk)
+				++stat_from_disk;
+			else
+				++stat_compiled;
+
+			*chunk = job->meta;
+			chunk->ref = luaL_ref(lua, LUA_REGISTRYINDEX);
+			g_hash_table_replace(chunk_cache, job->key, chunk);
+		}
+
+		if (job->chunk)
+			g_string_free(job->chunk, TRUE);
+		g_free(job->error);
+		g_free(job);
+	}
+
+	g_ptr_array_free(jobs, TRUE);
+#else
+	for (i = 0; i < filenames->len; i++) {
+		const char *filename = g_ptr_array_index(filenames, i);
+
+		if (!g_file_test(filename, G_FILE_TEST_EXISTS))
+			continue;
+
+		if (script_cache_refresh(lua, filename) != 0) {
+			logger_err_printf("%s\n", lua_tostring(lua, -1));
+			lua_pop(lua, 1);
+			++failed;
+		}
+	}
+#endif
+
+	return failed;
+}
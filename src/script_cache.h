@@ -0,0 +1,46 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __HEADER_SCRIPT_CACHE_
+#define __HEADER_SCRIPT_CACHE_
+
+#include <lua.h>
+#include <glib.h>
+
+/**
+ * Compiled-chunk cache.
+ * Scripts are compiled once and the resulting functions are kept in the
+ * Lua registry; running a script only needs a lua_pcall. Entries are
+ * dropped when the directory monitor reports that the file has changed.
+ */
+int script_cache_load(lua_State *lua, const char *filename);
+int script_cache_copy_chunk(lua_State *lua, const char *filename);
+int script_cache_refresh(lua_State *lua, const char *filename);
+guint script_cache_compile(lua_State *lua, GPtrArray *filenames);
+void script_cache_invalidate(const char *filename);
+void script_cache_clear(void);
+
+/**
+ * Optional on-disk store of compiled chunks, validated by source hash and
+ * Lua version, to speed up start-up.
+ */
+void script_cache_enable_disk(gboolean rebuild);
+void script_cache_rebuild_done(void);
+void script_cache_get_stats(guint *compiled, guint *from_disk);
+
+#endif /*__HEADER_SCRIPT_CACHE_*/
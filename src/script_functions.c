@@ -56,6 +56,10 @@
 #include "script.h"
 
 #include "xutils.h"
+#include "batch.h"
+#include "event_queue.h"
+#include "process_info.h"
+#include "config.h"
 
 #include "error_strings.h"
 
@@ -68,53 +72,18 @@
  */
 WnckWindow *current_window = NULL;
 
-static Bool current_time_cb(Display *display, XEvent *xevent, XPointer arg)
-{
-	Window wnd = GPOINTER_TO_UINT(arg);
-
-	if (xevent->type == PropertyNotify &&
-	    xevent->xproperty.window == wnd &&
-	    xevent->xproperty.atom == my_wnck_atom_get("WM_NAME"))
-		return True;
-
-	return False;
-}
-
 /**
  * Get current X11 timestamp.
  *
  * Unfortunately, gtk_get_current_event_time() does not work here
  * because we cannot assume we are inside an event.
- *
- * Getting this timestamp is tricky. According to a comment in the ICCCM
- * specification (https://tronche.com/gui/x/icccm/sec-2.html#s-2.1):
- *
- *     A zero-length append to a property is a way to obtain a
- *     timestamp for this purpose; the timestamp is in the
- *     corresponding PropertyNotify event.
- *
- * So here we are zero-length appending to the "WM_NAME" property.
  */
 static guint32 current_time(void)
 {
-	WnckWindow *window;
-	gulong wnd;
-	Display *dpy;
-	Atom prop;
-	XEvent xevent;
-
-	window = get_current_window();
-	if (!window)
+	if (!get_current_window())
 		return GDK_CURRENT_TIME;
 
-	dpy = gdk_x11_get_default_xdisplay();
-	wnd = wnck_window_get_xid(window);
-	prop = my_wnck_atom_get("WM_NAME");
-	XChangeProperty(dpy, wnd, prop, XA_STRING, 8, PropModeAppend, NULL, 0);
-
-	/* Wait for the event to succeed */
-	XIfEvent(dpy, &xevent, current_time_cb, GUINT_TO_POINTER(wnd));
-	return xevent.xproperty.time;
+	return devilspie2_get_server_time();
 }
 
 
@@ -381,10 +350,9 @@ int c_set_window_geometry2(lua_State *lua)
 		int ysize = lua_tonumber(lua, 4);
 		WnckWindow *window = get_current_window();
 		if (window) {
-			XMoveResizeWindow(gdk_x11_get_default_xdisplay(),
-			                  wnck_window_get_xid(window),
-			                  x, y,
-			                  xsize, ysize);
+			XWindowChanges changes = { .x = x, .y = y, .width = xsize, .height = ysize };
+			batch_configure(wnck_window_get_xid(window),
+			                CWX | CWY | CWWidth | CWHeight, &changes);
 		}
 	}
 
@@ -408,10 +376,10 @@ int c_set_window_position(lua_State *lua)
 		if (window) {
 			if (adjusting_for_decoration)
 				adjust_for_decoration(window, &x, &y, NULL, NULL);
-			wnck_window_set_geometry(window,
-			                         WNCK_WINDOW_GRAVITY_CURRENT,
-			                         WNCK_WINDOW_CHANGE_X + WNCK_WINDOW_CHANGE_Y,
-			                         x, y, -1, -1);
+			batch_set_geometry(window,
+			                   WNCK_WINDOW_GRAVITY_CURRENT,
+			                   WNCK_WINDOW_CHANGE_X + WNCK_WINDOW_CHANGE_Y,
+			                   x, y, -1, -1);
 		}
 	}
 
@@ -433,9 +401,8 @@ int c_set_window_position2(lua_State *lua)
 	else if (ret > 0) {
 		WnckWindow *window = get_current_window();
 		if (window) {
-			XMoveWindow(GDK_DISPLAY_XDISPLAY(gdk_display_get_default()),
-			            wnck_window_get_xid(window),
-			            x, y);
+			XWindowChanges changes = { .x = x, .y = y };
+			batch_configure(wnck_window_get_xid(window), CWX | CWY, &changes);
 		}
 	}
 
@@ -463,6 +430,7 @@ int c_set_window_size(lua_State *lua)
 
 	int x = lua_tonumber(lua,1);
 	int y = lua_tonumber(lua,2);
+	gboolean result = TRUE;
 
 	if (!devilspie2_emulate) {
 
@@ -470,25 +438,19 @@ int c_set_window_size(lua_State *lua)
 
 		if (window) {
 
-			devilspie2_error_trap_push();
 			if (adjusting_for_decoration)
 				adjust_for_decoration (window, NULL, NULL, &x, &y);
-			wnck_window_set_geometry(window,
-			                         WNCK_WINDOW_GRAVITY_CURRENT,
-			                         WNCK_WINDOW_CHANGE_WIDTH + WNCK_WINDOW_CHANGE_HEIGHT,
-			                         -1, -1, x, y);
-
-			if (devilspie2_error_trap_pop()) {
-				gchar *temperror=
-				    g_strdup_printf("set_window_size: %s", failed_string);
-				g_printerr("%s", temperror);
-
-				g_free(temperror);
-			}
+			result = batch_set_geometry(window,
+			                            WNCK_WINDOW_GRAVITY_CURRENT,
+			                            WNCK_WINDOW_CHANGE_WIDTH + WNCK_WINDOW_CHANGE_HEIGHT,
+			                            -1, -1, x, y);
+			if (!result)
+				g_printerr("set_window_size: %s", failed_string);
 		}
 	}
 
-	return 0;
+	lua_pushboolean(lua, result);
+	return 1;
 }
 
 
@@ -542,14 +504,9 @@ int c_set_window_strut(lua_State *lua)
 		WnckWindow *window = get_current_window();
 
 		if (window) {
-			XChangeProperty(dpy,
-			                wnck_window_get_xid(window),
-			                XInternAtom(dpy, "_NET_WM_STRUT_PARTIAL", False), XA_CARDINAL,
-			                32,
-			                PropModeReplace,
-			                (unsigned char*)struts,
-			                NUM_STRUTS);
-			XSync(dpy, False);
+			batch_change_property(wnck_window_get_xid(window),
+			                      atom_get(ATOM__NET_WM_STRUT_PARTIAL),
+			                      XA_CARDINAL, 32, struts, NUM_STRUTS);
 		}
 	}
 
@@ -575,12 +532,12 @@ int c_get_window_strut(lua_State *lua)
 	int len = 0;
 
 	gboolean ret = my_wnck_get_cardinal_list (wnck_window_get_xid(window),
-	                                          XInternAtom(dpy, "_NET_WM_STRUT_PARTIAL", False),
+	                                          atom_get(ATOM__NET_WM_STRUT_PARTIAL),
 	                                          &struts, &len);
 	/* if that fails, try reading the older, deprecated property */
 	if (!ret)
 		ret = my_wnck_get_cardinal_list (wnck_window_get_xid(window),
-		                                 XInternAtom(dpy, "_NET_WM_STRUT", False),
+		                                 atom_get(ATOM__NET_WM_STRUT),
 		                                 &struts, &len);
 
 	if (len) {
@@ -621,7 +578,7 @@ int c_make_always_on_top(lua_State *lua)
 		WnckWindow *window = get_current_window();
 
 		if (window) {
-			wnck_window_make_above(window);
+			batch_call(window, wnck_window_make_above);
 		}
 	}
 
@@ -641,8 +598,10 @@ int c_set_on_top(lua_State *lua)
 	if (!devilspie2_emulate) {
 		WnckWindow *window = get_current_window();
 
-		if (window)
-			XRaiseWindow(gdk_x11_get_default_xdisplay(), wnck_window_get_xid(window));
+		if (window) {
+			XWindowChanges changes = { .stack_mode = Above };
+			batch_configure(wnck_window_get_xid(window), CWStackMode, &changes);
+		}
 	}
 
 	return 0;
@@ -661,8 +620,10 @@ int c_set_on_bottom(lua_State *lua)
 	if (!devilspie2_emulate) {
 		WnckWindow *window = get_current_window();
 
-		if (window)
-			XLowerWindow(gdk_x11_get_default_xdisplay(), wnck_window_get_xid(window));
+		if (window) {
+			XWindowChanges changes = { .stack_mode = Below };
+			batch_configure(wnck_window_get_xid(window), CWStackMode, &changes);
+		}
 	}
 
 	return 0;
@@ -742,7 +703,7 @@ int c_shade(lua_State *lua)
 		WnckWindow *window = get_current_window();
 
 		if (window) {
-			wnck_window_shade(window);
+			batch_call(window, wnck_window_shade);
 		}
 	}
 
@@ -763,7 +724,7 @@ int c_unshade(lua_State *lua)
 		WnckWindow *window = get_current_window();
 
 		if (window) {
-			wnck_window_unshade(window);
+			batch_call(window, wnck_window_unshade);
 		}
 	}
 
@@ -784,7 +745,7 @@ int c_minimize(lua_State *lua)
 		WnckWindow *window = get_current_window();
 
 		if (window && FALSE == wnck_window_is_minimized(window)) {
-			wnck_window_minimize(window);
+			batch_call(window, wnck_window_minimize);
 		}
 	}
 
@@ -805,6 +766,7 @@ int c_unminimize(lua_State *lua)
 		WnckWindow *window = get_current_window();
 
 		if (window && TRUE == wnck_window_is_minimized(window)) {
+			batch_flush();
 			wnck_window_unminimize (window, current_time());
 		}
 	}
@@ -846,15 +808,13 @@ int c_undecorate_window(lua_State *lua)
 		WnckWindow *window = get_current_window();
 
 		if (window) {
-			gulong xid = wnck_window_get_xid(window);
-
-			if (!undecorate_window(xid)) {
-				result=FALSE;
-			}
+			result = batch_set_decorated(wnck_window_get_xid(window), FALSE);
 		}
 	}
 
-	lua_pushboolean(lua,result);
+	// FALSE only if the window has gone: the change is sent when the
+	// script stops, and any error then is ignored (see batch_flush)
+	lua_pushboolean(lua, result);
 
 	return 1;
 }
@@ -875,15 +835,13 @@ int c_decorate_window(lua_State *lua)
 		WnckWindow *window = get_current_window();
 
 		if (window) {
-			gulong xid = wnck_window_get_xid(window);
-
-			if (!decorate_window(xid)) {
-				result=FALSE;
-			}
+			result = batch_set_decorated(wnck_window_get_xid(window), TRUE);
 		}
 	}
 
-	lua_pushboolean(lua,result);
+	// FALSE only if the window has gone: the change is sent when the
+	// script stops, and any error then is ignored (see batch_flush)
+	lua_pushboolean(lua, result);
 
 	return 1;
 }
@@ -1034,7 +992,7 @@ int c_set_window_workspace(lua_State *lua)
 		}
 		if (!devilspie2_emulate) {
 			if(current_ws != workspace) { // Avoid a no-op
-				wnck_window_move_to_workspace(window, workspace);
+				batch_set_workspace(window, workspace_idx0);
 			}
 		}
 	}
@@ -1089,6 +1047,7 @@ int c_change_workspace(lua_State *lua)
 
 		gint64 timestamp = g_get_real_time();
 		if (!devilspie2_emulate) {
+			batch_flush();
 			wnck_workspace_activate(workspace, timestamp / 1000000);
 		}
 	}
@@ -1186,7 +1145,7 @@ int c_unmaximize(lua_State *lua)
 	if (!devilspie2_emulate) {
 		WnckWindow *window = get_current_window();
 		if (window) {
-			wnck_window_unmaximize(window);
+			batch_call(window, wnck_window_unmaximize);
 		}
 	}
 
@@ -1206,7 +1165,7 @@ int c_maximize(lua_State *lua)
 	if (!devilspie2_emulate) {
 		WnckWindow *window = get_current_window();
 		if (window) {
-			wnck_window_maximize(window);
+			batch_call(window, wnck_window_maximize);
 		}
 	}
 	return 0;
@@ -1225,7 +1184,7 @@ int c_maximize_vertically(lua_State *lua)
 	if (!devilspie2_emulate) {
 		WnckWindow *window = get_current_window();
 		if (window) {
-			wnck_window_maximize_vertically(window);
+			batch_call(window, wnck_window_maximize_vertically);
 		}
 	}
 
@@ -1245,7 +1204,7 @@ int c_maximize_horizontally(lua_State *lua)
 	if (!devilspie2_emulate) {
 		WnckWindow *window = get_current_window();
 		if (window) {
-			wnck_window_maximize_horizontally(window);
+			batch_call(window, wnck_window_maximize_horizontally);
 		}
 	}
 
@@ -1271,7 +1230,7 @@ int c_pin_window(lua_State *lua)
 	if (!devilspie2_emulate) {
 		WnckWindow *window = get_current_window();
 		if (window) {
-			wnck_window_pin(window);
+			batch_call(window, wnck_window_pin);
 		}
 	}
 
@@ -1292,7 +1251,7 @@ int c_unpin_window(lua_State *lua)
 	if (!devilspie2_emulate) {
 		WnckWindow *window = get_current_window();
 		if (window) {
-			wnck_window_unpin(window);
+			batch_call(window, wnck_window_unpin);
 		}
 	}
 
@@ -1312,7 +1271,7 @@ int c_stick_window(lua_State *lua)
 	if (!devilspie2_emulate) {
 		WnckWindow *window = get_current_window();
 		if (window) {
-			wnck_window_stick(window);
+			batch_call(window, wnck_window_stick);
 		}
 	}
 
@@ -1332,7 +1291,7 @@ int c_unstick_window(lua_State *lua)
 	if (!devilspie2_emulate) {
 		WnckWindow *window = get_current_window();
 		if (window) {
-			wnck_window_unstick(window);
+			batch_call(window, wnck_window_unstick);
 		}
 	}
 
@@ -1410,12 +1369,11 @@ int c_get_window_frame_extents(lua_State *lua)
 		// _NET_FRAME_EXTENTS
 		// Calculation from geometries
 
-		Display *dpy = gdk_x11_get_default_xdisplay();
 		gulong *extents = 0;
 		int len = 0;
 
 		my_wnck_get_cardinal_list (wnck_window_get_xid(window),
-		                           XInternAtom(dpy, "_NET_FRAME_EXTENTS", False),
+		                           atom_get(ATOM__NET_FRAME_EXTENTS),
 		                           &extents, &len);
 		if (len >= 4) {
 			// _NET_FRAME_EXTENTS
@@ -1470,7 +1428,7 @@ int c_set_skip_tasklist(lua_State *lua)
 	if (!devilspie2_emulate) {
 		WnckWindow *window = get_current_window();
 		if (window) {
-			wnck_window_set_skip_tasklist(window, skip_tasklist);
+			batch_call_bool(window, wnck_window_set_skip_tasklist, skip_tasklist);
 		}
 	}
 
@@ -1501,7 +1459,7 @@ int c_set_skip_pager(lua_State *lua)
 	if (!devilspie2_emulate) {
 		WnckWindow *window = get_current_window();
 		if (window) {
-			wnck_window_set_skip_pager(window, skip_pager);
+			batch_call_bool(window, wnck_window_set_skip_pager, skip_pager);
 		}
 	}
 
@@ -1629,9 +1587,9 @@ int c_set_window_above(lua_State *lua)
 
 		if (window) {
 			if (set_above)
-				wnck_window_make_above(window);
+				batch_call(window, wnck_window_make_above);
 			else
-				wnck_window_unmake_above(window);
+				batch_call(window, wnck_window_unmake_above);
 		}
 	}
 
@@ -1669,9 +1627,9 @@ int c_set_window_below(lua_State *lua)
 
 		if (window) {
 			if (set_below)
-				wnck_window_make_below(window);
+				batch_call(window, wnck_window_make_below);
 			else
-				wnck_window_unmake_below(window);
+				batch_call(window, wnck_window_unmake_below);
 		}
 	}
 
@@ -1679,6 +1637,37 @@ int c_set_window_below(lua_State *lua)
 }
 
 
+/**
+ * Returns the window type as used by get_window_type()
+ */
+const char *get_window_type_name(WnckWindow *window)
+{
+	if (!window)
+		return "WINDOW_ERROR";
+
+	switch (wnck_window_get_window_type(window)) {
+	case WNCK_WINDOW_NORMAL:
+		return "WINDOW_TYPE_NORMAL";
+	case WNCK_WINDOW_DESKTOP:
+		return "WINDOW_TYPE_DESKTOP";
+	case WNCK_WINDOW_DOCK:
+		return "WINDOW_TYPE_DOCK";
+	case WNCK_WINDOW_DIALOG:
+		return "WINDOW_TYPE_DIALOG";
+	case WNCK_WINDOW_TOOLBAR:
+		return "WINDOW_TYPE_TOOLBAR";
+	case WNCK_WINDOW_MENU:
+		return "WINDOW_TYPE_MENU";
+	case WNCK_WINDOW_UTILITY:
+		return "WINDOW_TYPE_UTILITY";
+	case WNCK_WINDOW_SPLASHSCREEN:
+		return "WINDOW_TYPE_SPLASHSCREEN";
+	default:
+		return "WINDOW_TYPE_UNRECOGNIZED";
+	};
+}
+
+
 /**
  *
  */
@@ -1688,45 +1677,7 @@ int c_get_window_type(lua_State *lua)
 		return 0;
 	}
 
-	WnckWindow *window = get_current_window();
-	const char *window_type_string;
-
-	if (window) {
-		WnckWindowType window_type = wnck_window_get_window_type(window);
-
-		switch (window_type) {
-		case WNCK_WINDOW_NORMAL:
-			window_type_string = "WINDOW_TYPE_NORMAL";
-			break;
-		case WNCK_WINDOW_DESKTOP:
-			window_type_string = "WINDOW_TYPE_DESKTOP";
-			break;
-		case WNCK_WINDOW_DOCK:
-			window_type_string = "WINDOW_TYPE_DOCK";
-			break;
-		case WNCK_WINDOW_DIALOG:
-			window_type_string = "WINDOW_TYPE_DIALOG";
-			break;
-		case WNCK_WINDOW_TOOLBAR:
-			window_type_string = "WINDOW_TYPE_TOOLBAR";
-			break;
-		case WNCK_WINDOW_MENU:
-			window_type_string = "WINDOW_TYPE_MENU";
-			break;
-		case WNCK_WINDOW_UTILITY:
-			window_type_string = "WINDOW_TYPE_UTILITY";
-			break;
-		case WNCK_WINDOW_SPLASHSCREEN:
-			window_type_string = "WINDOW_TYPE_SPLASHSCREEN";
-			break;
-		default:
-			window_type_string = "WINDOW_TYPE_UNRECOGNIZED";
-		};
-	} else {
-		window_type_string = "WINDOW_ERROR";
-	}
-
-	lua_pushstring(lua, window_type_string);
+	lua_pushstring(lua, get_window_type_name(get_current_window()));
 
 	return 1;
 }
@@ -1836,6 +1787,101 @@ int c_get_window_property_full(lua_State *lua)
 }
 
 
+#define DEFAULT_PROPERTY_DATA_BYTES 65536
+
+/**
+ * Returns a property's value without conversion to string:
+ * a string of bytes (format 8), a list of atom names (ATOM) or a list of
+ * integers; then its type name and the number of bytes not read.
+ * 	get_window_property_data(property, [type], [max_bytes])
+ */
+int c_get_window_property_data(lua_State *lua)
+{
+	if (!check_param_counts_range(lua, "get_window_property_data", 1, 3)) {
+		return 0;
+	}
+
+	int top = lua_gettop(lua);
+
+	if (lua_type(lua, 1) != LUA_TSTRING) {
+		luaL_error(lua, "get_window_property_data: %s", string_expected_as_indata_error);
+		return 0;
+	}
+	if (top >= 2 && lua_type(lua, 2) != LUA_TSTRING && lua_type(lua, 2) != LUA_TNIL) {
+		luaL_error(lua, "get_window_property_data: %s", string_expected_as_indata_error);
+		return 0;
+	}
+	if (top >= 3 && lua_type(lua, 3) != LUA_TNUMBER) {
+		luaL_error(lua, "get_window_property_data: %s", number_expected_as_indata_error);
+		return 0;
+	}
+
+	Atom req_type = AnyPropertyType;
+	lua_Number max_bytes = DEFAULT_PROPERTY_DATA_BYTES;
+
+	if (top >= 2 && lua_type(lua, 2) == LUA_TSTRING)
+		req_type = my_wnck_atom_get(lua_tostring(lua, 2));
+	if (top >= 3)
+		max_bytes = lua_tonumber(lua, 3);
+	if (max_bytes < 0)
+		max_bytes = 0;
+	if (max_bytes > G_MAXLONG)
+		max_bytes = G_MAXLONG;
+
+	WnckWindow *window = get_current_window();
+	struct raw_property prop;
+
+	if (!window ||
+	    !get_window_property_data(wnck_window_get_xid(window), my_wnck_atom_get(lua_tostring(lua, 1)),
+	                              req_type, (gulong)max_bytes, &prop) ||
+	    prop.type == None) {
+		lua_pushnil(lua);
+		return 1;
+	}
+
+	gulong i;
+
+	if (!prop.data) {
+		// the type didn't match
+		lua_pushnil(lua);
+	} else if (prop.format == 8) {
+		lua_pushlstring(lua, (const char *)prop.data, prop.nitems);
+	} else if (prop.type == XA_ATOM && prop.format == 32) {
+		gchar **names = get_atom_names((const Atom *)prop.data, prop.nitems);
+
+		lua_createtable(lua, prop.nitems, 0);
+		for (i = 0; i < prop.nitems; ++i) {
+			lua_pushstring(lua, names[i]);
+			lua_rawseti(lua, -2, i + 1);
+		}
+		g_strfreev(names);
+	} else {
+		// Xlib sign-extends; INTEGER is the only signed type
+		gboolean is_signed = prop.type == XA_INTEGER;
+
+		lua_createtable(lua, prop.nitems, 0);
+		for (i = 0; i < prop.nitems; ++i) {
+			long value = prop.format == 32 ? ((long *)prop.data)[i] : ((short *)prop.data)[i];
+
+			if (prop.format == 32)
+				lua_pushinteger(lua, is_signed ? (lua_Integer)(int32_t)value : (lua_Integer)(uint32_t)value);
+			else
+				lua_pushinteger(lua, is_signed ? (lua_Integer)(int16_t)value : (lua_Integer)(uint16_t)value);
+			lua_rawseti(lua, -2, i + 1);
+		}
+	}
+
+	gchar **type_name = get_atom_names(&prop.type, 1);
+	lua_pushstring(lua, type_name[0]);
+	g_strfreev(type_name);
+
+	lua_pushinteger(lua, prop.bytes_after);
+
+	g_free(prop.data);
+	return 3;
+}
+
+
 /**
  *
  */
@@ -1932,7 +1978,7 @@ int c_get_window_role(lua_State *lua)
 	WnckWindow *window = get_current_window();
 
 	if (window) {
-		char *result = my_wnck_get_string_property(wnck_window_get_xid(window), my_wnck_atom_get("WM_WINDOW_ROLE"), NULL);
+		char *result = my_wnck_get_string_property(wnck_window_get_xid(window), atom_get(ATOM_WM_WINDOW_ROLE), NULL);
 
 		lua_pushstring(lua, result ? result : "");
 		g_free (result);
@@ -1963,15 +2009,10 @@ int c_get_window_xid(lua_State *lua)
 
 
 /**
- *
+ * Returns the window class as used by get_window_class()
  */
-int c_get_window_class(lua_State *lua)
+const char *get_window_class_name(WnckWindow *window)
 {
-	if (!check_param_count(lua, "get_window_class", 0)) {
-		return 0;
-	}
-
-	WnckWindow *window = get_current_window();
 	const char *result = "";
 
 	if (window) {
@@ -1989,7 +2030,20 @@ int c_get_window_class(lua_State *lua)
 		}
 	}
 
-	lua_pushstring(lua, result);
+	return result ? result : "";
+}
+
+
+/**
+ *
+ */
+int c_get_window_class(lua_State *lua)
+{
+	if (!check_param_count(lua, "get_window_class", 0)) {
+		return 0;
+	}
+
+	lua_pushstring(lua, get_window_class_name(get_current_window()));
 
 	return 1;
 }
@@ -2017,7 +2071,7 @@ int c_set_window_fullscreen(lua_State *lua)
 	gboolean fullscreen = lua_toboolean(lua, 1);
 
 	if (!devilspie2_emulate && window) {
-		wnck_window_set_fullscreen(window, fullscreen);
+		batch_call_bool(window, wnck_window_set_fullscreen, fullscreen);
 	}
 
 
@@ -2083,12 +2137,8 @@ int c_set_viewport(lua_State *lua)
 		x = ((num - 1) * wnck_screen_get_width(screen)) - viewport_start_x + win_x;
 
 		if (!devilspie2_emulate) {
-			devilspie2_error_trap_push();
-			XMoveResizeWindow(gdk_x11_get_default_xdisplay(),
-			                  wnck_window_get_xid(window),
-			                  x, win_y, width, height);
-
-			if (devilspie2_error_trap_pop()) {
+			XWindowChanges changes = { .x = x, .y = win_y, .width = width, .height = height };
+			if (!batch_configure(xid, CWX | CWY | CWWidth | CWHeight, &changes)) {
 				g_printerr("set_viewport: %s", setting_viewport_failed_error);
 				lua_pushboolean(lua, FALSE);
 				return 1;
@@ -2133,12 +2183,8 @@ int c_set_viewport(lua_State *lua)
 		}
 
 		if (!devilspie2_emulate) {
-			devilspie2_error_trap_push();
-			XMoveResizeWindow(gdk_x11_get_default_xdisplay(),
-			                  wnck_window_get_xid(window),
-			                  new_xpos, new_ypos, width, height);
-
-			if (devilspie2_error_trap_pop()) {
+			XWindowChanges changes = { .x = new_xpos, .y = new_ypos, .width = width, .height = height };
+			if (!batch_configure(xid, CWX | CWY | CWWidth | CWHeight, &changes)) {
 				g_printerr("set_viewport: %s", setting_viewport_failed_error);
 				lua_pushboolean(lua, FALSE);
 				return 1;
@@ -2226,12 +2272,8 @@ int c_center(lua_State *lua)
 		window_r.y = desktop_r.y + desktop_r.height - window_r.height;
 
 	if (!devilspie2_emulate) {
-		devilspie2_error_trap_push();
-		XMoveWindow (gdk_x11_get_default_xdisplay(),
-		             wnck_window_get_xid(window),
-		             window_r.x, window_r.y);
-
-		if (devilspie2_error_trap_pop()) {
+		XWindowChanges changes = { .x = window_r.x, .y = window_r.y };
+		if (!batch_configure(wnck_window_get_xid(window), CWX | CWY, &changes)) {
 			g_printerr("center: %s", failed_string);
 			lua_pushboolean(lua, FALSE);
 			return 1;
@@ -2340,6 +2382,8 @@ int c_focus(lua_State *lua)
 	WnckWindow *window = get_current_window();
 
 	if (!devilspie2_emulate && window) {
+		// anything else the script has done goes first
+		batch_flush();
 		wnck_window_activate(window, current_time());
 	}
 
@@ -2359,6 +2403,7 @@ int c_close_window(lua_State *lua)
 	WnckWindow *window = get_current_window();
 
 	if (!devilspie2_emulate && window) {
+		batch_flush();
 		wnck_window_close(window, current_time());
 	}
 
@@ -2505,10 +2550,10 @@ int c_xy(lua_State *lua)
 			if (window) {
 				if (adjusting_for_decoration)
 					adjust_for_decoration (window, &x, &y, NULL, NULL);
-				wnck_window_set_geometry(window,
-				                         WNCK_WINDOW_GRAVITY_CURRENT,
-				                         WNCK_WINDOW_CHANGE_X + WNCK_WINDOW_CHANGE_Y,
-				                         x, y, -1, -1);
+				batch_set_geometry(window,
+				                   WNCK_WINDOW_GRAVITY_CURRENT,
+				                   WNCK_WINDOW_CHANGE_X + WNCK_WINDOW_CHANGE_Y,
+				                   x, y, -1, -1);
 			}
 		}
 		break;
@@ -2587,18 +2632,21 @@ struct lua_callback {
 	int ref;
 };
 
+static void run_geometry_callback(WnckWindow *window, gpointer data)
+{
+	struct lua_callback *callback = data;
+
+	lua_rawgeti(callback->lua, LUA_REGISTRYINDEX, callback->ref);
+	run_function(callback->lua, window, 0);
+}
+
 static void on_geometry_changed(WnckWindow *window, struct lua_callback *callback)
 {
 	if (callback == NULL)
 		return;
 
-	WnckWindow *old_window = get_current_window();
-	set_current_window(window);
-
-	lua_rawgeti(callback->lua, LUA_REGISTRYINDEX, callback->ref);
-	lua_pcall(callback->lua, 0, 0, 0);
-
-	set_current_window(old_window);
+	// a move or resize usually produces a burst of these
+	event_queue_add(window, geometry_change_delay, run_geometry_callback, callback);
 }
 
 static void on_geometry_changed_disconnect(gpointer data, GClosure *closure G_GNUC_UNUSED)
@@ -2621,7 +2669,8 @@ int c_on_geometry_changed(lua_State *lua)
 	}
 
 	struct lua_callback *cb = g_malloc(sizeof(struct lua_callback));
-	cb->lua = lua;
+	// not the calling coroutine, which won't be around for long
+	cb->lua = script_main_state(lua);
 	cb->ref = luaL_ref(lua, LUA_REGISTRYINDEX);
 
 	WnckWindow *window = get_current_window();
@@ -2636,9 +2685,6 @@ int c_on_geometry_changed(lua_State *lua)
 /**
  * returns the process binary name
  */
-static ATTR_MALLOC gchar *c_get_process_name_INT_proc(lua_State *, pid_t);
-static ATTR_MALLOC gchar *c_get_process_name_INT_ps(lua_State *, pid_t);
-
 int c_get_process_name(lua_State *lua)
 {
 	if (!check_param_count(lua, "get_process_name", 0)) {
@@ -2648,20 +2694,10 @@ int c_get_process_name(lua_State *lua)
 	WnckWindow *window = get_current_window();
 
 	if (window) {
-		pid_t pid = wnck_window_get_pid(window);
-
-		if (pid != 0) {
-			gchar *cmdname = c_get_process_name_INT_proc(lua, pid);
-			if (!cmdname)
-				cmdname = c_get_process_name_INT_ps(lua, pid);
+		const struct process_info *info = get_process_info(wnck_window_get_pid(window));
 
-			/* chop off any trailing LF */
-			gchar *lf = cmdname + strlen(cmdname) - 1;
-			if (lf >= cmdname && *lf == '\n')
-				*lf = 0;
-
-			lua_pushstring(lua, cmdname ? cmdname : "");
-			g_free(cmdname);
+		if (info) {
+			lua_pushstring(lua, info->comm);
 			return 1;
 		}
 	}
@@ -2670,57 +2706,58 @@ int c_get_process_name(lua_State *lua)
 	return 1;
 }
 
-static gchar *c_get_process_name_INT_proc(lua_State *lua, pid_t pid)
+
+/**
+ * returns a table of details of the process owning the window
+ */
+int c_get_process_info(lua_State *lua)
 {
-	/* 16 is fine for cmdname on Linux. Could be longer elsewhere, though. */
-	char cmd[1024], cmdname[1024];
-	FILE *cmdfp;
+	if (!check_param_count(lua, "get_process_info", 0)) {
+		return 0;
+	}
 
-	cmdname[0] = 0;
+	WnckWindow *window = get_current_window();
+	const struct process_info *info = window ? get_process_info(wnck_window_get_pid(window)) : NULL;
 
-	snprintf(cmd, sizeof(cmd), "/proc/%lu/comm", (unsigned long)pid);
-	cmdfp = fopen(cmd, "r");
-	if (cmdfp == NULL) {
-		if (errno != ENOENT && errno != EACCES) {
-			luaL_error(lua, "get_process_name: Failed to open \"%s\" (%d).", cmd, errno);
-		}
-		return NULL;
+	if (!info) {
+		lua_pushnil(lua);
+		return 1;
 	}
 
-	if (fgets(cmdname, sizeof(cmdname), cmdfp) == NULL) {
-		fclose(cmdfp);
-		luaL_error(lua, "get_process_name: Failed to read from \"%s\".", cmd);
-		return NULL;
-	}
+	lua_newtable(lua);
 
-	fclose(cmdfp);
-	return g_strdup(cmdname);
-}
+	lua_pushinteger(lua, info->pid);
+	lua_setfield(lua, -2, "pid");
+	lua_pushinteger(lua, info->ppid);
+	lua_setfield(lua, -2, "ppid");
+	lua_pushstring(lua, info->comm);
+	lua_setfield(lua, -2, "name");
 
-static gchar *c_get_process_name_INT_ps(lua_State *lua, pid_t pid)
-{
-	char cmd[1024], cmdname[1024];
-	FILE *cmdfp;
+	if (info->exe) {
+		lua_pushstring(lua, info->exe);
+		lua_setfield(lua, -2, "exe");
+	}
 
-	/* I'd like to use "ps ho comm c %lu" here.
-	 * Seems that FreeBSD ps outputs headers regardless.
-	 * (Tested using procps 'ps' with PS_PERSONALITY=bsd)
-	 */
-	snprintf(cmd, sizeof(cmd), "ps o comm c %lu | tail -n 1", (unsigned long)pid);
-	cmdfp = popen(cmd, "r");
-	if (cmdfp == NULL) {
-		luaL_error(lua, "get_process_name: Failed to run command \"%s\".", cmd);
-		return 0;
+	if (info->argv) {
+		gchar *cmdline = g_strjoinv(" ", info->argv);
+		lua_pushstring(lua, cmdline);
+		lua_setfield(lua, -2, "cmdline");
+		g_free(cmdline);
+
+		lua_newtable(lua);
+		for (int i = 0; info->argv[i]; i++) {
+			lua_pushstring(lua, info->argv[i]);
+			lua_rawseti(lua, -2, i + 1);
+		}
+		lua_setfield(lua, -2, "args");
 	}
 
-	if (fgets(cmdname, sizeof(cmdname), cmdfp) == NULL) {
-		pclose(cmdfp);
-		luaL_error(lua, "get_process_name: Failed to read output from command \"%s\".", cmd);
-		return 0;
+	if (info->cgroup) {
+		lua_pushstring(lua, info->cgroup);
+		lua_setfield(lua, -2, "cgroup");
 	}
 
-	pclose(cmdfp);
-	return g_strdup(cmdname);
+	return 1;
 }
 
 
@@ -2744,6 +2781,10 @@ int c_millisleep(lua_State *lua)
 		return 0;
 	}
 
+	// let everything else carry on while this script waits
+	if (script_can_yield(lua))
+		return script_sleep(lua, time);
+
 	struct timespec tv;
 	struct timespec left;
 	if (time == 1000) {
@@ -2760,6 +2801,36 @@ int c_millisleep(lua_State *lua)
 }
 
 
+/**
+ * Run a function later, working on the current window
+ */
+int c_after(lua_State *lua)
+{
+	if (!check_param_count(lua, "after", 2)) {
+		return 0;
+	}
+	if (lua_type(lua, 1) != LUA_TNUMBER) {
+		luaL_error(lua, "after: %s", number_expected_as_indata_error);
+		return 0;
+	}
+	if (lua_type(lua, 2) != LUA_TFUNCTION) {
+		luaL_error(lua, "after: %s", "function expected");
+		return 0;
+	}
+
+	lua_Number time = lua_tonumber(lua, 1);
+	if (time < 0 || time > 3600000) {
+		luaL_error(lua, _("after: time %g out of range (0..3600000)"), (double)time);
+		return 0;
+	}
+
+	// the function is at the top of the stack
+	run_function(lua, get_current_window(), time < 1 ? 1 : (guint)time);
+
+	return 0;
+}
+
+
 /*
  * Devilspie:
 
@@ -106,6 +106,7 @@ int c_set_on_top(lua_State *lua);
 int c_set_on_bottom(lua_State *lua);
 
 int c_get_window_type(lua_State *lua);
+const char *get_window_type_name(WnckWindow *window);
 
 // these two require GTK 3 or later
 int c_get_class_instance_name(lua_State *lua);
@@ -114,11 +115,13 @@ int c_get_class_group_name(lua_State *lua);
 int c_get_window_property(lua_State *lua);
 int c_window_property_is_utf8(lua_State *lua);
 int c_get_window_property_full(lua_State *lua);
+int c_get_window_property_data(lua_State *lua);
 int c_get_window_role(lua_State *lua);
 
 int c_get_window_xid(lua_State *lua);
 
 int c_get_window_class(lua_State *lua);
+const char *get_window_class_name(WnckWindow *window);
 
 int c_set_window_property(lua_State *lua);
 int c_delete_window_property(lua_State *lua);
@@ -146,7 +149,9 @@ int c_xywh(lua_State *lua);
 int c_on_geometry_changed(lua_State *lua);
 
 int c_get_process_name(lua_State *lua);
+int c_get_process_info(lua_State *lua);
 
 int c_millisleep(lua_State *lua);
+int c_after(lua_State *lua);
 
 #endif /*__HEADER_SCRIPT_FUNCTIONS_*/
@@ -0,0 +1,402 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <gdk/gdk.h>
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+
+#include <lua.h>
+#include <lauxlib.h>
+
+#define WNCK_I_KNOW_THIS_IS_UNSTABLE
+#include <libwnck/libwnck.h>
+
+#include "error_strings.h"
+#include "script_functions.h"
+#include "script_window.h"
+#include "window_index.h"
+#include "xutils.h"
+
+
+#define WINDOW_TYPE_NAME "devilspie2.window"
+
+// registry key for the table of handles, by XID (weak values)
+static char handles_key;
+
+
+/**
+ * The script functions which are available as window methods.
+ */
+static const struct {
+	const char *name;
+	lua_CFunction func;
+} window_methods[] = {
+	{ "get_window_name", c_get_window_name },
+	{ "get_window_has_name", c_get_window_has_name },
+	{ "set_window_position", c_set_window_position },
+	{ "set_window_position2", c_set_window_position2 },
+	{ "set_window_size", c_set_window_size },
+	{ "set_window_strut", c_set_window_strut },
+	{ "get_window_strut", c_get_window_strut },
+	{ "set_window_geometry", c_set_window_geometry },
+	{ "set_window_geometry2", c_set_window_geometry2 },
+	{ "get_application_name", c_get_application_name },
+	{ "shade", c_shade },
+	{ "unshade", c_unshade },
+	{ "maximize", c_maximize },
+	{ "maximise", c_maximize },
+	{ "maximize_horizontally", c_maximize_horizontally },
+	{ "maximise_horizontally", c_maximize_horizontally },
+	{ "maximize_vertically", c_maximize_vertically },
+	{ "maximise_vertically", c_maximize_vertically },
+	{ "unmaximize", c_unmaximize },
+	{ "unmaximise", c_unmaximize },
+	{ "minimize", c_minimize },
+	{ "minimise", c_minimize },
+	{ "unminimize", c_unminimize },
+	{ "unminimise", c_unminimize },
+	{ "decorate_window", c_decorate_window },
+	{ "undecorate_window", c_undecorate_window },
+	{ "get_window_is_decorated", c_get_window_is_decorated },
+	{ "get_window_workspace", c_get_window_workspace },
+	{ "set_window_workspace", c_set_window_workspace },
+	{ "pin_window", c_pin_window },
+	{ "unpin_window", c_unpin_window },
+	{ "stick_window", c_stick_window },
+	{ "unstick_window", c_unstick_window },
+	{ "close_window", c_close_window },
+	{ "get_window_geometry", c_get_window_geometry },
+	{ "get_window_client_geometry", c_get_window_client_geometry },
+	{ "get_window_frame_extents", c_get_window_frame_extents },
+	{ "set_skip_tasklist", c_set_skip_tasklist },
+	{ "set_skip_pager", c_set_skip_pager },
+	{ "get_window_is_minimized", c_get_window_is_minimized },
+	{ "get_window_is_minimised", c_get_window_is_minimized },
+	{ "get_window_is_maximized", c_get_window_is_maximized },
+	{ "get_window_is_maximised", c_get_window_is_maximized },
+	{ "get_window_is_maximized_vertically", c_get_window_is_maximized_vertically },
+	{ "get_window_is_maximised_vertically", c_get_window_is_maximized_vertically },
+	{ "get_window_is_maximized_horizontally", c_get_window_is_maximized_horizontally },
+	{ "get_window_is_maximised_horizontally", c_get_window_is_maximized_horizontally },
+	{ "get_window_is_pinned", c_get_window_is_pinned },
+	{ "set_window_below", c_set_window_below },
+	{ "set_window_above", c_set_window_above },
+	{ "set_window_fullscreen", c_set_window_fullscreen },
+	{ "get_window_fullscreen", c_get_window_fullscreen },
+	{ "make_always_on_top", c_make_always_on_top },
+	{ "set_on_top", c_set_on_top },
+	{ "set_on_bottom", c_set_on_bottom },
+	{ "get_window_type", c_get_window_type },
+	{ "set_window_type", c_set_window_type },
+	{ "get_window_property", c_get_window_property },
+	{ "window_property_is_utf8", c_window_property_is_utf8 },
+	{ "get_window_property_full", c_get_window_property_full },
+	{ "get_window_property_data", c_get_window_property_data },
+	{ "set_window_property", c_set_window_property },
+	{ "delete_window_property", c_delete_window_property },
+	{ "get_window_role", c_get_window_role },
+	{ "get_window_xid", c_get_window_xid },
+	{ "get_window_class", c_get_window_class },
+	{ "get_class_instance_name", c_get_class_instance_name },
+	{ "get_class_group_name", c_get_class_group_name },
+	{ "set_viewport", c_set_viewport },
+	{ "center", c_center },
+	{ "centre", c_center },
+	{ "set_window_opacity", c_set_window_opacity },
+	{ "set_opacity", c_set_window_opacity },
+	{ "focus", c_focus },
+	{ "focus_window", c_focus },
+	{ "get_monitor_index", c_get_monitor_index },
+	{ "xy", c_xy },
+	{ "xywh", c_xywh },
+	{ "on_geometry_changed", c_on_geometry_changed },
+	{ "get_process_name", c_get_process_name },
+	{ "get_process_info", c_get_process_info },
+	{ "after", c_after },
+};
+
+
+/**
+ * Returns the handle's window, or NULL if it has been closed.
+ * Raises an error if the value isn't a window handle.
+ */
+WnckWindow *check_window_handle(lua_State *lua, int index)
+{
+	gulong *xid = luaL_checkudata(lua, index, WINDOW_TYPE_NAME);
+
+	return wnck_handle_get_window(my_wnck_handle, *xid);
+}
+
+
+/**
+ * Push the window's handle (or nil, for no window).
+ */
+void push_window_handle(lua_State *lua, WnckWindow *window)
+{
+	gulong xid;
+
+	if (!window) {
+		lua_pushnil(lua);
+		return;
+	}
+
+	xid = wnck_window_get_xid(window);
+
+	lua_pushlightuserdata(lua, &handles_key);
+	lua_rawget(lua, LUA_REGISTRYINDEX);
+
+	lua_pushnumber(lua, xid);
+	lua_rawget(lua, -2);
+	if (lua_isnil(lua, -1)) {
+		gulong *handle;
+
+		lua_pop(lua, 1);
+		handle = lua_newuserdata(lua, sizeof(gulong));
+		*handle = xid;
+		luaL_getmetatable(lua, WINDOW_TYPE_NAME);
+		lua_setmetatable(lua, -2);
+
+		lua_pushnumber(lua, xid);
+		lua_pushvalue(lua, -2);
+		lua_rawset(lua, -4);
+	}
+
+	// drop the table of handles
+	lua_remove(lua, -2);
+}
+
+
+/**
+ * Call the script function (upvalue 1) with the handle's window as the
+ * current window. Returns nil if the window has been closed.
+ */
+static int window_method(lua_State *lua)
+{
+	WnckWindow *window = check_window_handle(lua, 1);
+	WnckWindow *old_window = get_current_window();
+	int status;
+
+	if (!window) {
+		lua_pushnil(lua);
+		return 1;
+	}
+
+	// replace the handle with the function
+	lua_pushvalue(lua, lua_upvalueindex(1));
+	lua_replace(lua, 1);
+
+	// the current window must be put back even if there's an error
+	set_current_window(window);
+	status = lua_pcall(lua, lua_gettop(lua) - 1, LUA_MULTRET, 0);
+	set_current_window(old_window);
+
+	if (status)
+		return lua_error(lua);
+	return lua_gettop(lua);
+}
+
+
+/**
+ * w:exists() - whether the window is still open
+ */
+static int window_exists(lua_State *lua)
+{
+	lua_pushboolean(lua, check_window_handle(lua, 1) != NULL);
+	return 1;
+}
+
+
+static int window_tostring(lua_State *lua)
+{
+	gulong *xid = luaL_checkudata(lua, 1, WINDOW_TYPE_NAME);
+
+	gchar *text = g_strdup_printf("window 0x%lx", *xid);
+
+	lua_pushstring(lua, text);
+	g_free(text);
+	return 1;
+}
+
+
+/**
+ * Set up the window handle type; call before running any scripts.
+ */
+void register_window_type(lua_State *lua)
+{
+	guint i;
+
+	// handles are kept only while scripts refer to them
+	lua_pushlightuserdata(lua, &handles_key);
+	lua_newtable(lua);
+	lua_newtable(lua);
+	lua_pushstring(lua, "v");
+	lua_setfield(lua, -2, "__mode");
+	lua_setmetatable(lua, -2);
+	lua_rawset(lua, LUA_REGISTRYINDEX);
+
+	luaL_newmetatable(lua, WINDOW_TYPE_NAME);
+
+	lua_newtable(lua);
+	for (i = 0; i < G_N_ELEMENTS(window_methods); ++i) {
+		lua_pushcfunction(lua, window_methods[i].func);
+		lua_pushcclosure(lua, window_method, 1);
+		lua_setfield(lua, -2, window_methods[i].name);
+	}
+	lua_pushcfunction(lua, window_exists);
+	lua_setfield(lua, -2, "exists");
+	lua_setfield(lua, -2, "__index");
+
+	lua_pushcfunction(lua, window_tostring);
+	lua_setfield(lua, -2, "__tostring");
+
+	// scripts shouldn't be able to change the methods
+	lua_pushboolean(lua, 0);
+	lua_setfield(lua, -2, "__metatable");
+
+	lua_pop(lua, 1);
+}
+
+
+static gboolean check_no_params(lua_State *lua, const char *funcname)
+{
+	if (lua_gettop(lua) != 0) {
+		luaL_error(lua, "%s: %s", funcname, num_indata_expected_errors[0]);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+
+/**
+ * Returns a list of handles for all windows, in the order in which they
+ * were opened.
+ */
+int c_get_windows(lua_State *lua)
+{
+	if (!check_no_params(lua, "get_windows")) {
+		return 0;
+	}
+
+	WnckScreen *screen = wnck_handle_get_default_screen(my_wnck_handle);
+	GList *item;
+	int i = 0;
+
+	lua_newtable(lua);
+	for (item = screen ? wnck_screen_get_windows(screen) : NULL; item; item = item->next) {
+		push_window_handle(lua, item->data);
+		lua_rawseti(lua, -2, ++i);
+	}
+
+	return 1;
+}
+
+
+/**
+ * Returns a handle for the active window, or nil.
+ */
+int c_get_active_window(lua_State *lua)
+{
+	if (!check_no_params(lua, "get_active_window")) {
+		return 0;
+	}
+
+	WnckScreen *screen = wnck_handle_get_default_screen(my_wnck_handle);
+
+	push_window_handle(lua, screen ? wnck_screen_get_active_window(screen) : NULL);
+	return 1;
+}
+
+
+/**
+ * Returns a handle for the window which the script is working on, or nil.
+ */
+int c_get_current_window(lua_State *lua)
+{
+	if (!check_no_params(lua, "get_current_window")) {
+		return 0;
+	}
+
+	push_window_handle(lua, get_current_window());
+	return 1;
+}
+
+
+/**
+ * Returns a list of handles for the open windows which match the given
+ * criteria, e.g. find_windows{class = "Firefox", workspace = 2}, in the
+ * order in which they were opened. The windows are looked up in the
+ * inventory (see window_index.c) rather than tested one by one.
+ */
+int c_find_windows(lua_State *lua)
+{
+	struct window_query query = { NULL, NULL, 0, 0 };
+	GList *windows, *item;
+	int i = 0;
+
+	if (lua_gettop(lua) != 1) {
+		luaL_error(lua, "find_windows: %s", num_indata_expected_errors[1]);
+		return 0;
+	}
+	if (!lua_istable(lua, 1)) {
+		luaL_error(lua, "find_windows: %s", table_expected_as_indata_error);
+		return 0;
+	}
+
+	lua_pushnil(lua);
+	while (lua_next(lua, 1)) {
+		const char *key = lua_type(lua, -2) == LUA_TSTRING ? lua_tostring(lua, -2) : "";
+
+		if (g_strcmp0(key, "class") == 0 || g_strcmp0(key, "role") == 0) {
+			if (lua_type(lua, -1) != LUA_TSTRING) {
+				luaL_error(lua, "find_windows: %s: %s", key, string_expected_as_indata_error);
+				return 0;
+			}
+			// the strings stay in the table, so remain valid
+			if (key[0] == 'c')
+				query.class = lua_tostring(lua, -1);
+			else
+				query.role = lua_tostring(lua, -1);
+		} else if (g_strcmp0(key, "pid") == 0 || g_strcmp0(key, "workspace") == 0) {
+			if (lua_type(lua, -1) != LUA_TNUMBER || lua_tointeger(lua, -1) <= 0) {
+				luaL_error(lua, "find_windows: %s: %s", key, integer_greater_than_zero_expected_error);
+				return 0;
+			}
+			if (key[0] == 'p')
+				query.pid = lua_tointeger(lua, -1);
+			else
+				query.workspace = lua_tointeger(lua, -1);
+		} else {
+			luaL_error(lua, "find_windows: %s '%s'", unknown_key_error, key);
+			return 0;
+		}
+		lua_pop(lua, 1);
+	}
+
+	windows = window_index_find(&query);
+
+	lua_newtable(lua);
+	for (item = windows; item; item = item->next) {
+		push_window_handle(lua, item->data);
+		lua_rawseti(lua, -2, ++i);
+	}
+	g_list_free(windows);
+
+	return 1;
+}
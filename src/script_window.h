@@ -0,0 +1,42 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __HEADER_SCRIPT_WINDOW_
+#define __HEADER_SCRIPT_WINDOW_
+
+#include <lua.h>
+#define WNCK_I_KNOW_THIS_IS_UNSTABLE
+#include <libwnck/libwnck.h>
+
+/**
+ * Window handles.
+ * A handle is a userdata holding a window's XID; its methods are the
+ * script functions which work on the current window, so that
+ * w:maximize() does to w what maximize() does to the current window.
+ * There is at most one handle per window, so handles can be compared.
+ */
+void register_window_type(lua_State *lua);
+void push_window_handle(lua_State *lua, WnckWindow *window);
+WnckWindow *check_window_handle(lua_State *lua, int index);
+
+int c_get_windows(lua_State *lua);
+int c_get_active_window(lua_State *lua);
+int c_get_current_window(lua_State *lua);
+int c_find_windows(lua_State *lua);
+
+#endif /*__HEADER_SCRIPT_WINDOW_*/
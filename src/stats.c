@@ -0,0 +1,172 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "intl.h"
+#include "stats.h"
+#include "logger.h"
+
+// the percentile is taken over the most recent samples only
+#define STATS_SAMPLES 256
+
+
+/**
+ *
+ */
+struct timing {
+	guint count;
+	gint64 total;
+	gint64 max;
+	gint64 samples[STATS_SAMPLES];
+};
+
+struct script_stats {
+	struct timing run;
+	gint64 load_total;	// loading from cache is counted too
+};
+
+// file name -> struct script_stats
+static GHashTable *script_stats = NULL;
+static struct timing event_stats[W_NUM_EVENTS];
+
+
+static void timing_add(struct timing *timing, gint64 time)
+{
+	timing->samples[timing->count % STATS_SAMPLES] = time;
+	timing->total += time;
+	if (time > timing->max)
+		timing->max = time;
+	++timing->count;
+}
+
+
+static int compare_times(const void *a, const void *b)
+{
+	gint64 x = *(const gint64 *)a, y = *(const gint64 *)b;
+	return (x > y) - (x < y);
+}
+
+
+static gint64 timing_p99(const struct timing *timing)
+{
+	guint n = MIN(timing->count, STATS_SAMPLES);
+	gint64 sorted[STATS_SAMPLES];
+
+	if (!n)
+		return 0;
+
+	memcpy(sorted, timing->samples, n * sizeof(gint64));
+	qsort(sorted, n, sizeof(gint64), compare_times);
+	return sorted[(n * 99 - 1) / 100];
+}
+
+
+/**
+ *
+ */
+void stats_record_script(const char *filename, gint64 load_time, gint64 run_time)
+{
+	struct script_stats *stats;
+
+	if (!script_stats)
+		script_stats = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+	stats = g_hash_table_lookup(script_stats, filename);
+	if (!stats) {
+		stats = g_new0(struct script_stats, 1);
+		g_hash_table_insert(script_stats, g_strdup(filename), stats);
+	}
+
+	timing_add(&stats->run, run_time);
+	stats->load_total += load_time;
+}
+
+
+/**
+ *
+ */
+void stats_record_event(win_event_type event, gint64 time)
+{
+	timing_add(&event_stats[event], time);
+}
+
+
+static gint compare_scripts(gconstpointer a, gconstpointer b)
+{
+	const struct script_stats *x = g_hash_table_lookup(script_stats, a);
+	const struct script_stats *y = g_hash_table_lookup(script_stats, b);
+
+	// slowest first
+	return (y->run.total > x->run.total) - (y->run.total < x->run.total);
+}
+
+
+static void append_timing(GString *out, const struct timing *timing)
+{
+	g_string_append_printf(out, "%8u %10.2f %8.3f %8.3f %8.3f",
+	                       timing->count, timing->total / 1000.0,
+	                       timing->count ? timing->total / 1000.0 / timing->count : 0.0,
+	                       timing_p99(timing) / 1000.0, timing->max / 1000.0);
+}
+
+
+/**
+ * Print everything recorded so far (times in ms), slowest scripts first.
+ */
+void stats_dump(void)
+{
+	GString *out = g_string_new(NULL);
+	win_event_type event;
+
+	g_string_append_printf(out, "%s\n%8s %10s %8s %8s %8s %8s  %s\n",
+	                       _("Script statistics (ms):"),
+	                       _("runs"), _("total"), _("mean"), _("p99"), _("max"), _("load"),
+	                       _("script"));
+
+	if (script_stats) {
+		GList *names = g_list_sort(g_hash_table_get_keys(script_stats), compare_scripts);
+		GList *name;
+
+		for (name = names; name; name = name->next) {
+			const struct script_stats *stats = g_hash_table_lookup(script_stats, name->data);
+			append_timing(out, &stats->run);
+			g_string_append_printf(out, " %8.3f  %s\n",
+			                       stats->load_total / 1000.0, (const char *)name->data);
+		}
+		g_list_free(names);
+	}
+
+	g_string_append_printf(out, "%s\n%8s %10s %8s %8s %8s  %s\n",
+	                       _("Event statistics (ms):"),
+	                       _("events"), _("total"), _("mean"), _("p99"), _("max"),
+	                       _("event"));
+
+	for (event = 0; event < W_NUM_EVENTS; event++) {
+		append_timing(out, &event_stats[event]);
+		g_string_append_printf(out, "  %s\n", event_names[event]);
+	}
+
+	logger_print_always(out->str);
+	g_string_free(out, TRUE);
+}
+
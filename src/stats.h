@@ -0,0 +1,35 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __HEADER_STATS_
+#define __HEADER_STATS_
+
+#include <glib.h>
+
+#include "config.h"
+
+/**
+ * Timing statistics: per script (load and run times) and per event type
+ * (time taken to run all of the event's scripts). All times are in
+ * microseconds, from g_get_monotonic_time().
+ */
+void stats_record_script(const char *filename, gint64 load_time, gint64 run_time);
+void stats_record_event(win_event_type event, gint64 time);
+void stats_dump(void);
+
+#endif /*__HEADER_STATS_*/
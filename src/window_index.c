@@ -0,0 +1,361 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <glib.h>
+#include <gdk/gdk.h>
+#include <gdk/gdkx.h>
+#include <X11/Xlib.h>
+
+#define WNCK_I_KNOW_THIS_IS_UNSTABLE
+#include <libwnck/libwnck.h>
+
+#include "script_functions.h"
+#include "window_index.h"
+#include "xutils.h"
+
+
+/**
+ * Every open window has an entry, which is in one set per index. Class
+ * and workspace are kept up to date from wnck's signals. Roles change
+ * rarely and are only needed by role queries, so a change of WM_WINDOW_ROLE
+ * just marks the entry's role as unknown, and unknown roles are read (from
+ * the property cache, see xutils.c) by the next query for a role.
+ */
+struct indexed_window {
+	WnckWindow *window;
+	Window xid;
+	guint64 serial;	// for returning windows in the order in which they were opened
+	gchar *class;
+	gchar *role;	// NULL while unknown
+	int pid;	// 0 if unknown
+	int workspace;	// from 1; 0 if on all workspaces or none
+};
+
+struct index {
+	GHashTable *sets;	// key => set of struct indexed_window
+	gboolean string_keys;
+};
+
+static GHashTable *windows = NULL;	// Window => struct indexed_window
+static GHashTable *unknown_roles = NULL;	// set of struct indexed_window
+static guint64 next_serial = 0;
+
+static struct index by_class = { NULL, TRUE };
+static struct index by_role = { NULL, TRUE };
+static struct index by_pid = { NULL, FALSE };
+static struct index by_workspace = { NULL, FALSE };
+
+
+static void index_init(struct index *index)
+{
+	if (index->string_keys)
+		index->sets = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+		                                    (GDestroyNotify)g_hash_table_destroy);
+	else
+		index->sets = g_hash_table_new_full(NULL, NULL, NULL,
+		                                    (GDestroyNotify)g_hash_table_destroy);
+}
+
+
+static void index_add(struct index *index, gconstpointer key, struct indexed_window *entry)
+{
+	GHashTable *set = g_hash_table_lookup(index->sets, key);
+
+	if (!set) {
+		set = g_hash_table_new(NULL, NULL);
+		g_hash_table_insert(index->sets,
+		                    index->string_keys ? g_strdup(key) : (gpointer)key, set);
+	}
+	g_hash_table_add(set, entry);
+}
+
+
+static void index_remove(struct index *index, gconstpointer key, struct indexed_window *entry)
+{
+	GHashTable *set = g_hash_table_lookup(index->sets, key);
+
+	if (set && g_hash_table_remove(set, entry) && g_hash_table_size(set) == 0)
+		g_hash_table_remove(index->sets, key);
+}
+
+
+static GHashTable *index_lookup(struct index *index, gconstpointer key)
+{
+	return g_hash_table_lookup(index->sets, key);
+}
+
+
+static int workspace_of(WnckWindow *window)
+{
+	WnckWorkspace *workspace = wnck_window_get_workspace(window);
+
+	return workspace ? wnck_workspace_get_number(workspace) + 1 : 0;
+}
+
+
+static struct indexed_window *find_entry(Window xid)
+{
+	return windows ? g_hash_table_lookup(windows, GUINT_TO_POINTER(xid)) : NULL;
+}
+
+
+static void forget_role(struct indexed_window *entry)
+{
+	if (!entry->role)
+		return;
+
+	index_remove(&by_role, entry->role, entry);
+	g_free(entry->role);
+	entry->role = NULL;
+	g_hash_table_add(unknown_roles, entry);
+}
+
+
+/**
+ * Read the roles which aren't known, for a query by role.
+ */
+static void read_unknown_roles(void)
+{
+	GHashTableIter iter;
+	gpointer key;
+
+	g_hash_table_iter_init(&iter, unknown_roles);
+	while (g_hash_table_iter_next(&iter, &key, NULL)) {
+		struct indexed_window *entry = key;
+
+		entry->role = my_wnck_get_string_property(entry->xid, atom_get(ATOM_WM_WINDOW_ROLE), NULL);
+		if (!entry->role)
+			entry->role = g_strdup("");
+		index_add(&by_role, entry->role, entry);
+		g_hash_table_iter_remove(&iter);
+	}
+}
+
+
+static GdkFilterReturn role_filter(GdkXEvent *gdk_xevent, GdkEvent *event G_GNUC_UNUSED, gpointer data G_GNUC_UNUSED)
+{
+	XEvent *xevent = (XEvent *)gdk_xevent;
+
+	if (xevent->type == PropertyNotify &&
+	    xevent->xproperty.atom == atom_get(ATOM_WM_WINDOW_ROLE)) {
+		struct indexed_window *entry = find_entry(xevent->xproperty.window);
+		if (entry)
+			forget_role(entry);
+	}
+
+	return GDK_FILTER_CONTINUE;
+}
+
+
+static void class_changed_cb(WnckWindow *window, gpointer data G_GNUC_UNUSED)
+{
+	struct indexed_window *entry = find_entry(wnck_window_get_xid(window));
+
+	if (!entry)
+		return;
+
+	index_remove(&by_class, entry->class, entry);
+	g_free(entry->class);
+	entry->class = g_strdup(get_window_class_name(window));
+	index_add(&by_class, entry->class, entry);
+}
+
+
+static void workspace_changed_cb(WnckWindow *window, gpointer data G_GNUC_UNUSED)
+{
+	struct indexed_window *entry = find_entry(wnck_window_get_xid(window));
+
+	if (!entry)
+		return;
+
+	index_remove(&by_workspace, GINT_TO_POINTER(entry->workspace), entry);
+	entry->workspace = workspace_of(window);
+	index_add(&by_workspace, GINT_TO_POINTER(entry->workspace), entry);
+}
+
+
+static void free_entry(gpointer data)
+{
+	struct indexed_window *entry = data;
+
+	g_signal_handlers_disconnect_by_func(entry->window, class_changed_cb, NULL);
+	g_signal_handlers_disconnect_by_func(entry->window, workspace_changed_cb, NULL);
+
+	index_remove(&by_class, entry->class, entry);
+	if (entry->role)
+		index_remove(&by_role, entry->role, entry);
+	else
+		g_hash_table_remove(unknown_roles, entry);
+	index_remove(&by_pid, GINT_TO_POINTER(entry->pid), entry);
+	index_remove(&by_workspace, GINT_TO_POINTER(entry->workspace), entry);
+
+	g_free(entry->class);
+	g_free(entry->role);
+	g_free(entry);
+}
+
+
+/**
+ * Add a window to the inventory; called when wnck reports it.
+ */
+void window_index_add(WnckWindow *window)
+{
+	struct indexed_window *entry;
+	Window xid = wnck_window_get_xid(window);
+
+	if (!windows) {
+		windows = g_hash_table_new_full(NULL, NULL, NULL, free_entry);
+		unknown_roles = g_hash_table_new(NULL, NULL);
+		index_init(&by_class);
+		index_init(&by_role);
+		index_init(&by_pid);
+		index_init(&by_workspace);
+		gdk_window_add_filter(NULL, role_filter, NULL);
+	}
+
+	if (xid == None || g_hash_table_contains(windows, GUINT_TO_POINTER(xid)))
+		return;
+
+	entry = g_new0(struct indexed_window, 1);
+	entry->window = window;
+	entry->xid = xid;
+	entry->serial = next_serial++;
+	entry->class = g_strdup(get_window_class_name(window));
+	entry->pid = wnck_window_get_pid(window);
+	entry->workspace = workspace_of(window);
+
+	index_add(&by_class, entry->class, entry);
+	g_hash_table_add(unknown_roles, entry);
+	index_add(&by_pid, GINT_TO_POINTER(entry->pid), entry);
+	index_add(&by_workspace, GINT_TO_POINTER(entry->workspace), entry);
+	g_hash_table_insert(windows, GUINT_TO_POINTER(xid), entry);
+
+	g_signal_connect(window, "class-changed", (GCallback)class_changed_cb, NULL);
+	g_signal_connect(window, "workspace-changed", (GCallback)workspace_changed_cb, NULL);
+}
+
+
+/**
+ * Remove a window from the inventory; called when it is closed.
+ */
+void window_index_remove(WnckWindow *window)
+{
+	if (windows)
+		g_hash_table_remove(windows, GUINT_TO_POINTER(wnck_window_get_xid(window)));
+}
+
+
+static gboolean entry_matches(const struct indexed_window *entry, const struct window_query *query)
+{
+	if (query->class && g_strcmp0(entry->class, query->class) != 0)
+		return FALSE;
+	if (query->role && g_strcmp0(entry->role, query->role) != 0)
+		return FALSE;
+	if (query->pid && entry->pid != query->pid)
+		return FALSE;
+	// windows on all workspaces are on this one too
+	if (query->workspace && entry->workspace != query->workspace &&
+	    !(entry->workspace == 0 && wnck_window_is_pinned(entry->window)))
+		return FALSE;
+	return TRUE;
+}
+
+
+/**
+ * Make the smallest set so far the one to search. FALSE if there is no
+ * set, i.e. nothing can match.
+ */
+static gboolean narrow(GHashTable **search, GHashTable *set)
+{
+	if (!set)
+		return FALSE;
+	if (!*search || g_hash_table_size(set) < g_hash_table_size(*search))
+		*search = set;
+	return TRUE;
+}
+
+
+static GList *collect(GList *result, GHashTable *set, const struct window_query *query)
+{
+	GHashTableIter iter;
+	gpointer value;
+
+	if (!set)
+		return result;
+
+	// (in sets, as in the window table, the values are the entries)
+	g_hash_table_iter_init(&iter, set);
+	while (g_hash_table_iter_next(&iter, NULL, &value)) {
+		struct indexed_window *entry = value;
+		if (entry_matches(entry, query))
+			result = g_list_prepend(result, entry);
+	}
+
+	return result;
+}
+
+
+static gint compare_serials(gconstpointer a, gconstpointer b)
+{
+	const struct indexed_window *entry1 = a;
+	const struct indexed_window *entry2 = b;
+
+	return (entry1->serial > entry2->serial) - (entry1->serial < entry2->serial);
+}
+
+
+/**
+ * Find the open windows which match the query, in the order in which they
+ * were opened. Only the smallest of the index sets which apply is searched.
+ * Free the list (not the windows) with g_list_free().
+ */
+GList *window_index_find(const struct window_query *query)
+{
+	GHashTable *search = NULL;
+	GList *result = NULL;
+	GList *item;
+
+	if (!windows)
+		return NULL;
+
+	if (query->role)
+		read_unknown_roles();
+
+	if (query->class && !narrow(&search, index_lookup(&by_class, query->class)))
+		return NULL;
+	if (query->role && !narrow(&search, index_lookup(&by_role, query->role)))
+		return NULL;
+	if (query->pid && !narrow(&search, index_lookup(&by_pid, GINT_TO_POINTER(query->pid))))
+		return NULL;
+
+	if (search) {
+		result = collect(result, search, query);
+	} else if (query->workspace) {
+		result = collect(result, index_lookup(&by_workspace, GINT_TO_POINTER(query->workspace)), query);
+		result = collect(result, index_lookup(&by_workspace, GINT_TO_POINTER(0)), query);
+	} else {
+		result = collect(result, windows, query);
+	}
+
+	result = g_list_sort(result, compare_serials);
+	for (item = result; item; item = item->next)
+		item->data = ((struct indexed_window *)item->data)->window;
+
+	return result;
+}
@@ -0,0 +1,46 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef __HEADER_WINDOW_INDEX_
+#define __HEADER_WINDOW_INDEX_
+
+#include <glib.h>
+#define WNCK_I_KNOW_THIS_IS_UNSTABLE
+#include <libwnck/libwnck.h>
+
+/**
+ * What to look for; NULL or 0 means "any".
+ * workspace counts from 1, as in scripts.
+ */
+struct window_query {
+	const gchar *class;
+	const gchar *role;
+	int pid;
+	int workspace;
+};
+
+/**
+ * The inventory of open windows, indexed by class, role, pid and
+ * workspace. Windows are added and removed as wnck reports them.
+ */
+void window_index_add(WnckWindow *window);
+void window_index_remove(WnckWindow *window);
+
+GList *window_index_find(const struct window_query *query);
+
+#endif /*__HEADER_WINDOW_INDEX_*/
@@ -27,12 +27,22 @@
 
 // FIXME: retrieve screen position via wnck
 #include <X11/extensions/Xinerama.h>
+#ifdef HAVE_XRANDR
+#include <X11/extensions/Xrandr.h>
+#endif
+
+#ifdef HAVE_XCB
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#include <stdlib.h>
+#endif
 
 #define WNCK_I_KNOW_THIS_IS_UNSTABLE
 #include <libwnck/libwnck.h>
 
 #include <locale.h>
 
+#include "batch.h"
 #include "intl.h"
 #include "xutils.h"
 
@@ -42,9 +52,55 @@
 #endif
 
 
+WnckHandle *my_wnck_handle = NULL;
+
 static GHashTable *atom_hash = NULL;
 static GHashTable *reverse_atom_hash = NULL;
 
+#define DEVILSPIE2_ATOM_NAME(name) #name,
+static char *atom_names[ATOM_COUNT] = {
+	DEVILSPIE2_ATOMS(DEVILSPIE2_ATOM_NAME)
+};
+#undef DEVILSPIE2_ATOM_NAME
+
+static Atom atom_table[ATOM_COUNT];
+static gboolean atoms_interned = FALSE;
+
+
+/**
+ * Intern all of our atoms with one request.
+ */
+static void intern_atoms(void)
+{
+	int i;
+
+	if (!XInternAtoms(gdk_x11_get_default_xdisplay(), atom_names, ATOM_COUNT, False, atom_table))
+		g_printerr("%s\n", _("Couldn't intern X atoms"));
+
+	// so that scripts asking for these by name don't cost a round trip
+	atom_hash = g_hash_table_new (g_str_hash, g_str_equal);
+	reverse_atom_hash = g_hash_table_new (NULL, NULL);
+	for (i = 0; i < ATOM_COUNT; ++i) {
+		if (atom_table[i] == None)
+			continue;
+		g_hash_table_insert(atom_hash, atom_names[i], GUINT_TO_POINTER(atom_table[i]));
+		g_hash_table_insert(reverse_atom_hash, GUINT_TO_POINTER(atom_table[i]), atom_names[i]);
+	}
+
+	atoms_interned = TRUE;
+}
+
+
+/**
+ *
+ */
+Atom atom_get(enum atom_id id)
+{
+	if (G_UNLIKELY(!atoms_interned))
+		intern_atoms();
+	return atom_table[id];
+}
+
 
 /**
  *
@@ -55,10 +111,8 @@ Atom my_wnck_atom_get(const char *atom_name)
 
 	g_return_val_if_fail (atom_name != NULL, None);
 
-	if (!atom_hash) {
-		atom_hash = g_hash_table_new (g_str_hash, g_str_equal);
-		reverse_atom_hash = g_hash_table_new (NULL, NULL);
-	}
+	if (!atoms_interned)
+		intern_atoms();
 
 	retval = GPOINTER_TO_UINT (g_hash_table_lookup (atom_hash, atom_name));
 	if (!retval) {
@@ -100,7 +154,7 @@ void devilspie2_change_state(Screen *screen, Window xwindow,
 	xev.xclient.send_event = True;
 	xev.xclient.display = gdk_x11_get_default_xdisplay();
 	xev.xclient.window = xwindow;
-	xev.xclient.message_type = my_wnck_atom_get ("_NET_WM_STATE");
+	xev.xclient.message_type = atom_get(ATOM__NET_WM_STATE);
 	xev.xclient.format = 32;
 	xev.xclient.data.l[0] = add ? _NET_WM_STATE_ADD : _NET_WM_STATE_REMOVE;
 	xev.xclient.data.l[1] = state1;
@@ -128,119 +182,684 @@ void devilspie2_error_trap_push()
 
 
 /**
- *
+ * Returns the first error caught (0 if none). Waits for the X server only
+ * if some request made inside the trap may not have been answered yet.
  */
 int devilspie2_error_trap_pop()
 {
 #if GTK_CHECK_VERSION(3, 0, 0)
+	// GDK only syncs if it has to
 	return gdk_x11_display_error_trap_pop(gdk_display_get_default());
 #else
-	XSync(gdk_x11_get_default_xdisplay(),False);
+	Display *display = gdk_x11_get_default_xdisplay();
+
+	// any errors from answered requests have already been seen
+	if (XLastKnownRequestProcessed(display) + 1 < XNextRequest(display))
+		XSync(display, False);
 	return gdk_error_trap_pop();
 #endif
 }
 
 
 /**
- *
+ * For requests whose errors don't matter (write-only ones, where the usual
+ * error is that the window has gone): don't wait for the X server; errors
+ * are matched against the trap as they arrive and dropped.
  */
-static void set_decorations(Window xid /*WnckWindow *window*/, gboolean decorate)
+void devilspie2_error_trap_pop_ignored()
 {
-#define PROP_MOTIF_WM_HINTS_ELEMENTS 5
-#define MWM_HINTS_DECORATIONS (1L << 1)
-	struct {
-		unsigned long flags;
-		unsigned long functions;
-		unsigned long decorations;
-		long inputMode;
-		unsigned long status;
-	} hints = {0,};
+#if GTK_CHECK_VERSION(3, 0, 0)
+	gdk_x11_display_error_trap_pop_ignored(gdk_display_get_default());
+#else
+	// GTK2 can't do that: an error arriving after the trap is gone is fatal
+	devilspie2_error_trap_pop();
+#endif
+}
 
-	hints.flags = MWM_HINTS_DECORATIONS;
-	hints.decorations = decorate ? 1 : 0;
 
-	/* Set Motif hints, most window managers handle these */
-	XChangeProperty(gdk_x11_get_default_xdisplay(), xid /*wnck_window_get_xid (window)*/,
-	                my_wnck_atom_get ("_MOTIF_WM_HINTS"),
-	                my_wnck_atom_get ("_MOTIF_WM_HINTS"), 32, PropModeReplace,
-	                (unsigned char *)&hints, PROP_MOTIF_WM_HINTS_ELEMENTS);
+/**
+ * X server timestamps.
+ * Every event carrying a timestamp is noted by an event filter; if the
+ * latest is recent enough, it's used as is. Otherwise we do a zero-length
+ * append to a property on our own hidden window (ICCCM 2.1) and take the
+ * time from the PropertyNotify.
+ */
+#define TIMESTAMP_MAX_AGE 100 // ms
 
+static Window timestamp_window = None;
+static Time last_timestamp = CurrentTime;
+static gint64 last_timestamp_at = 0;
 
-	//Window   xid;
-	XWindowAttributes attrs;
 
-	//xid = wnck_window_get_xid (window);
-	XGetWindowAttributes(gdk_x11_get_default_xdisplay(), xid, &attrs);
+static void note_timestamp(Time time)
+{
+	last_timestamp = time;
+	last_timestamp_at = g_get_monotonic_time();
+}
 
-	/* Apart from OpenBox, which doesn't respect it changing after mapping.
-	 * Instead it has this workaround.
-	 */
-	devilspie2_change_state (attrs.screen,
-	                         xid /*wnck_window_get_xid(window)*/, !decorate,
-	                         my_wnck_atom_get ("_OB_WM_STATE_UNDECORATED"), 0);
 
+static GdkFilterReturn timestamp_filter(GdkXEvent *gdk_xevent, GdkEvent *event G_GNUC_UNUSED, gpointer data G_GNUC_UNUSED)
+{
+	XEvent *xevent = (XEvent *)gdk_xevent;
+
+	switch (xevent->type) {
+	case KeyPress:
+	case KeyRelease:
+		note_timestamp(xevent->xkey.time);
+		break;
+	case ButtonPress:
+	case ButtonRelease:
+		note_timestamp(xevent->xbutton.time);
+		break;
+	case MotionNotify:
+		note_timestamp(xevent->xmotion.time);
+		break;
+	case EnterNotify:
+	case LeaveNotify:
+		note_timestamp(xevent->xcrossing.time);
+		break;
+	case PropertyNotify:
+		note_timestamp(xevent->xproperty.time);
+		break;
+	case SelectionClear:
+		note_timestamp(xevent->xselectionclear.time);
+		break;
+	case SelectionRequest:
+		note_timestamp(xevent->xselectionrequest.time);
+		break;
+	case SelectionNotify:
+		note_timestamp(xevent->xselection.time);
+		break;
+	}
+
+	return GDK_FILTER_CONTINUE;
+}
+
+
+static Bool timestamp_event_cb(Display *display G_GNUC_UNUSED, XEvent *xevent, XPointer arg G_GNUC_UNUSED)
+{
+	return xevent->type == PropertyNotify &&
+	       xevent->xproperty.window == timestamp_window;
 }
 
 
 /**
- *
+ * Start noting timestamps, and create the window used to ask for one.
  */
-gboolean decorate_window(Window xid)
+static void timestamp_init(void)
 {
-	devilspie2_error_trap_push();
+	Display *dpy = gdk_x11_get_default_xdisplay();
+	XSetWindowAttributes attrs;
+
+	attrs.override_redirect = True;
+	attrs.event_mask = PropertyChangeMask;
+	timestamp_window = XCreateWindow(dpy, DefaultRootWindow(dpy), -100, -100, 1, 1, 0,
+	                                 CopyFromParent, InputOnly, CopyFromParent,
+	                                 CWOverrideRedirect | CWEventMask, &attrs);
+	gdk_window_add_filter(NULL, timestamp_filter, NULL);
+}
 
-	set_decorations(xid, TRUE);
 
-	if (devilspie2_error_trap_pop()) {
-		g_printerr("decorate_window %s\n", _("Failed!"));
-		return FALSE;
+/**
+ * Get the current X server time, for requests which need a timestamp.
+ */
+Time devilspie2_get_server_time(void)
+{
+	Display *dpy = gdk_x11_get_default_xdisplay();
+	XEvent xevent;
+
+	if (last_timestamp != CurrentTime &&
+	    g_get_monotonic_time() - last_timestamp_at < TIMESTAMP_MAX_AGE * 1000)
+		return last_timestamp;
+
+	// in case xutils_init() hasn't been called
+	if (timestamp_window == None)
+		timestamp_init();
+
+	XChangeProperty(dpy, timestamp_window, atom_get(ATOM__DEVILSPIE2_TIMESTAMP),
+	                XA_STRING, 8, PropModeAppend, NULL, 0);
+
+	/* Wait for the event to succeed */
+	XIfEvent(dpy, &xevent, timestamp_event_cb, NULL);
+	note_timestamp(xevent.xproperty.time);
+
+	return last_timestamp;
+}
+
+
+/**
+ * Set up what is needed from start-up on: our atoms, and the timestamps
+ * of incoming events, which must be noted before anything asks for one.
+ */
+void xutils_init(void)
+{
+	if (!atoms_interned)
+		intern_atoms();
+	if (timestamp_window == None)
+		timestamp_init();
+}
+
+
+/**
+ * Property cache.
+ * Property reads for windows which we track (every window which wnck has
+ * told us about) are kept with the window, and each one is dropped when
+ * the X server tells us that it has changed (PropertyNotify; wnck selects
+ * for these on all client windows) or when the window is closed. Scripts
+ * asking for the same property, whether for the same event or later ones,
+ * therefore cost one round trip between them.
+ * For other windows, reads are kept only while scripts are being run for
+ * the window and are discarded once they have finished.
+ */
+/**
+ * What we know about a tracked window.
+ */
+struct window_state {
+	Screen *screen;	// NULL until first asked for
+	GHashTable *properties;	// Atom => struct raw_property
+};
+
+// Bigger properties (icons, mostly) are never kept
+#define MAX_CACHED_PROPERTY 4096
+
+// How much of a property is read unless more is needed
+#define PROPERTY_FIRST_READ 65536
+
+static GHashTable *window_states = NULL;	// Window => struct window_state
+
+static GHashTable *property_cache = NULL;
+static Window property_cache_xid = None;
+static int property_cache_depth = 0;
+
+
+static void free_raw_property(gpointer data)
+{
+	struct raw_property *prop = data;
+	g_free(prop->data);
+	g_free(prop);
+}
+
+
+static void free_window_state(gpointer data)
+{
+	struct window_state *state = data;
+	g_hash_table_destroy(state->properties);
+	g_free(state);
+}
+
+
+static struct window_state *find_window_state(Window xid)
+{
+	if (!window_states || xid == None)
+		return NULL;
+	return g_hash_table_lookup(window_states, GUINT_TO_POINTER(xid));
+}
+
+
+/**
+ * Which property table, if any, reads for this window go into.
+ */
+static GHashTable *property_table(Window xid)
+{
+	struct window_state *state = find_window_state(xid);
+
+	if (state)
+		return state->properties;
+	if (property_cache_depth && xid == property_cache_xid)
+		return property_cache;
+	return NULL;
+}
+
+
+static GdkFilterReturn window_state_filter(GdkXEvent *gdk_xevent, GdkEvent *event G_GNUC_UNUSED, gpointer data G_GNUC_UNUSED)
+{
+	XEvent *xevent = (XEvent *)gdk_xevent;
+
+	if (xevent->type == PropertyNotify) {
+		struct window_state *state = find_window_state(xevent->xproperty.window);
+		if (state)
+			g_hash_table_remove(state->properties, GUINT_TO_POINTER(xevent->xproperty.atom));
 	}
 
-	return TRUE;
+	return GDK_FILTER_CONTINUE;
+}
+
+
+/**
+ * Start keeping state for a window; called when wnck reports it.
+ */
+void window_state_track(Window xid)
+{
+	struct window_state *state;
+
+	if (!window_states) {
+		window_states = g_hash_table_new_full(NULL, NULL, NULL, free_window_state);
+		gdk_window_add_filter(NULL, window_state_filter, NULL);
+	}
+
+	if (xid == None || g_hash_table_contains(window_states, GUINT_TO_POINTER(xid)))
+		return;
+
+	state = g_new0(struct window_state, 1);
+	state->properties = g_hash_table_new_full(NULL, NULL, NULL, free_raw_property);
+	g_hash_table_insert(window_states, GUINT_TO_POINTER(xid), state);
+}
+
+
+/**
+ * Drop everything kept for a window; called when it is closed.
+ */
+void window_state_forget(Window xid)
+{
+	if (window_states)
+		g_hash_table_remove(window_states, GUINT_TO_POINTER(xid));
+}
+
+
+/**
+ *
+ */
+void property_cache_begin(Window xid)
+{
+	if (property_cache_depth++)
+		return;
+
+	property_cache_xid = xid;
+	if (!property_cache)
+		property_cache = g_hash_table_new_full(NULL, NULL, NULL, free_raw_property);
 }
 
 
 /**
  *
  */
-gboolean undecorate_window(Window xid)
+void property_cache_end(void)
 {
+	if (property_cache_depth == 0 || --property_cache_depth)
+		return;
+
+	property_cache_xid = None;
+	g_hash_table_remove_all(property_cache);
+}
+
+
+/**
+ * Drop a cached property; called whenever we change it.
+ */
+void property_cache_forget(Window xid, Atom atom)
+{
+	GHashTable *table = property_table(xid);
+
+	if (table)
+		g_hash_table_remove(table, GUINT_TO_POINTER(atom));
+}
+
+
+/**
+ * Read up to length 32-bit units of a property, if it has the given type.
+ */
+static void fetch_property_range(Window xwindow, Atom atom, Atom req_type, long length,
+                                 struct raw_property *prop)
+{
+	unsigned char *property = NULL;
+	int err, result;
+
+	memset(prop, 0, sizeof(*prop));
+
 	devilspie2_error_trap_push();
+	result = XGetWindowProperty (gdk_x11_get_default_xdisplay (),
+	                             xwindow, atom,
+	                             0, length,
+	                             False, req_type, &prop->type,
+	                             &prop->format, &prop->nitems,
+	                             &prop->bytes_after, &property);
 
-	set_decorations(xid, FALSE);
+	err = devilspie2_error_trap_pop ();
+	if (err != Success || result != Success)
+		return;
+
+	prop->ok = TRUE;
+	if (property) {
+		// Xlib gives an empty buffer, not NULL, if the type didn't match
+		if (req_type == AnyPropertyType || prop->type == req_type) {
+			gsize unit = prop->format == 32 ? sizeof(long) : (gsize)prop->format / 8;
+			gsize size = unit * prop->nitems;
+			prop->data = g_malloc(size + 1);
+			memcpy(prop->data, property, size);
+			prop->data[size] = 0;
+		}
+		XFree(property);
+	}
+}
 
-	if (devilspie2_error_trap_pop()) {
-		g_printerr("decorate_window %s\n", _("Failed!"));
-		return FALSE;
+
+/**
+ * Whether a property has been read only in part, but is of a type which
+ * is converted to a string and so is needed in full.
+ */
+static gboolean is_incomplete_text(const struct raw_property *prop)
+{
+	return prop->ok && prop->bytes_after &&
+	       (prop->type == XA_STRING || prop->type == XA_ATOM ||
+	        prop->type == atom_get(ATOM_UTF8_STRING));
+}
+
+
+/**
+ * Read a property. Only the first PROPERTY_FIRST_READ bytes are asked for,
+ * so that reading e.g. _NET_WM_ICON doesn't pull megabytes over the wire;
+ * the rest of a string (rarely needed) costs a second round trip.
+ */
+static void fetch_raw_property(Window xwindow, Atom atom, struct raw_property *prop)
+{
+	fetch_property_range(xwindow, atom, AnyPropertyType, PROPERTY_FIRST_READ / 4, prop);
+
+	if (is_incomplete_text(prop)) {
+		g_free(prop->data);
+		fetch_property_range(xwindow, atom, AnyPropertyType, G_MAXLONG, prop);
+	}
+}
+
+
+/**
+ * Properties which scripts commonly ask for when a window is opened.
+ */
+static const enum atom_id prefetch_atoms[] = {
+	ATOM_WM_CLASS,
+	ATOM_WM_NAME,
+	ATOM_WM_WINDOW_ROLE,
+	ATOM__NET_WM_NAME,
+	ATOM__NET_WM_PID,
+	ATOM__NET_WM_WINDOW_TYPE,
+	ATOM__NET_FRAME_EXTENTS,
+	ATOM__MOTIF_WM_HINTS,
+};
+
+
+/**
+ * Fill the property cache for a window in one go: the requests are all
+ * sent before any reply is read, so the cost is one round trip rather than
+ * one per property. Properties which are already known aren't re-read.
+ * Does nothing unless the window is tracked or the cache is active for it.
+ */
+void property_cache_prefetch(Window xid)
+{
+#ifdef HAVE_XCB
+	enum { N_PREFETCH = G_N_ELEMENTS(prefetch_atoms) };
+	Display *display = gdk_x11_get_default_xdisplay();
+	xcb_connection_t *conn;
+	xcb_get_property_cookie_t cookies[N_PREFETCH];
+	GHashTable *table = property_table(xid);
+	Atom atoms[N_PREFETCH];
+	int i;
+
+	if (!table)
+		return;
+
+	for (i = 0; i < N_PREFETCH; ++i) {
+		atoms[i] = atom_get(prefetch_atoms[i]);
+		if (g_hash_table_contains(table, GUINT_TO_POINTER(atoms[i])))
+			atoms[i] = None;
+	}
+
+	// make sure that anything queued by Xlib goes out first
+	XFlush(display);
+	conn = XGetXCBConnection(display);
+
+	for (i = 0; i < N_PREFETCH; ++i)
+		if (atoms[i] != None)
+			cookies[i] = xcb_get_property(conn, 0, xid, atoms[i],
+			                              XCB_GET_PROPERTY_TYPE_ANY, 0, PROPERTY_FIRST_READ / 4);
+
+	for (i = 0; i < N_PREFETCH; ++i) {
+		xcb_get_property_reply_t *reply;
+		xcb_generic_error_t *error = NULL;
+		struct raw_property *prop;
+
+		if (atoms[i] == None)
+			continue;
+
+		reply = xcb_get_property_reply(conn, cookies[i], &error);
+		prop = g_new0(struct raw_property, 1);
+
+		if (reply) {
+			gulong n = xcb_get_property_value_length(reply);
+			const void *value = xcb_get_property_value(reply);
+
+			prop->ok = TRUE;
+			prop->type = reply->type;
+			prop->format = reply->format;
+			prop->nitems = reply->value_len;
+			prop->bytes_after = reply->bytes_after;
+
+			if (reply->type != XCB_NONE) {
+				if (reply->format == 32) {
+					// Xlib hands out format 32 data as longs
+					const uint32_t *in = value;
+					long *out = g_new(long, prop->nitems + 1);
+					gulong j;
+
+					for (j = 0; j < prop->nitems; ++j)
+						out[j] = in[j];
+					out[j] = 0;
+					prop->data = (guchar *)out;
+				} else {
+					prop->data = g_malloc(n + 1);
+					memcpy(prop->data, value, n);
+					prop->data[n] = 0;
+				}
+			}
+			free(reply);
+		}
+		free(error);
+
+		// a long string will be re-read in full when asked for
+		if (is_incomplete_text(prop))
+			free_raw_property(prop);
+		else
+			g_hash_table_insert(table, GUINT_TO_POINTER(atoms[i]), prop);
+	}
+#else
+	(void)xid;
+#endif
+}
+
+
+/**
+ * Read a property, via the cache if the window is tracked or the cache is
+ * active for it. Pass the result to release_raw_property() when done.
+ */
+static const struct raw_property *get_raw_property(Window xwindow, Atom atom, struct raw_property *scratch)
+{
+	GHashTable *table;
+	struct raw_property *prop;
+
+	// scripts should see their own changes
+	batch_flush_window(xwindow);
+
+	table = property_table(xwindow);
+	if (table) {
+		prop = g_hash_table_lookup(table, GUINT_TO_POINTER(atom));
+		if (prop)
+			return prop;
+	}
+
+	fetch_raw_property(xwindow, atom, scratch);
+
+	if (table && (!scratch->ok || scratch->nitems * (scratch->format / 8) <= MAX_CACHED_PROPERTY)) {
+		prop = g_new(struct raw_property, 1);
+		*prop = *scratch;
+		g_hash_table_insert(table, GUINT_TO_POINTER(atom), prop);
+		return prop;
 	}
 
+	return scratch;
+}
+
+
+static void release_raw_property(const struct raw_property *prop, struct raw_property *scratch)
+{
+	if (prop == scratch)
+		g_free(scratch->data);
+}
+
+
+/**
+ * Read at most max_bytes of a property, and only if it is of type req_type
+ * (which may be AnyPropertyType); a complete copy in the cache is used if
+ * there is one. As with XGetWindowProperty(), if the type doesn't match,
+ * prop has the actual type and format, no data and the size in
+ * bytes_after. Returns FALSE if the read failed; free prop->data after.
+ */
+gboolean get_window_property_data(Window xwindow, Atom atom, Atom req_type, gulong max_bytes,
+                                  struct raw_property *prop)
+{
+	const struct raw_property *cached = NULL;
+	GHashTable *table;
+	gulong size, keep;
+	gsize unit;
+
+	// scripts should see their own changes
+	batch_flush_window(xwindow);
+
+	if (max_bytes > G_MAXLONG - 3)
+		max_bytes = G_MAXLONG - 3;
+
+	table = property_table(xwindow);
+	if (table)
+		cached = g_hash_table_lookup(table, GUINT_TO_POINTER(atom));
+
+	if (cached && cached->ok && !cached->bytes_after) {
+		*prop = *cached;
+		prop->data = NULL;
+		if (prop->type == None)
+			return TRUE;
+		if (req_type != AnyPropertyType && prop->type != req_type) {
+			prop->bytes_after = prop->nitems * (prop->format / 8);
+			prop->nitems = 0;
+			return TRUE;
+		}
+	} else {
+		fetch_property_range(xwindow, atom, req_type, (max_bytes + 3) / 4, prop);
+		if (!prop->ok || !prop->data)
+			return prop->ok;
+	}
+
+	// trim to max_bytes; the server works in 32-bit units
+	size = prop->format / 8;
+	keep = MIN(prop->nitems, max_bytes / size);
+	prop->bytes_after += (prop->nitems - keep) * size;
+	prop->nitems = keep;
+
+	unit = prop->format == 32 ? sizeof(long) : size;
+	if (cached) {
+		prop->data = g_malloc(unit * keep + 1);
+		memcpy(prop->data, cached->data, unit * keep);
+	}
+	prop->data[unit * keep] = 0;
+
 	return TRUE;
 }
 
 
+/**
+ * Look up the names of several atoms; those which we already know cost
+ * nothing, and the rest are asked for together. Unknown atoms are given
+ * as "". Free the result with g_strfreev().
+ */
+gchar **get_atom_names(const Atom *atoms, int count)
+{
+	gchar **names = g_new0(gchar *, count + 1);
+	Atom *missing = g_new(Atom, count);
+	int *where = g_new(int, count);
+	int i, n = 0;
+
+	if (!atoms_interned)
+		intern_atoms();
+
+	for (i = 0; i < count; ++i) {
+		const char *name = g_hash_table_lookup(reverse_atom_hash, GUINT_TO_POINTER(atoms[i]));
+		if (name) {
+			names[i] = g_strdup(name);
+		} else {
+			missing[n] = atoms[i];
+			where[n++] = i;
+		}
+	}
+
+	if (n) {
+		char **found = g_new0(char *, n);
+
+		devilspie2_error_trap_push();
+		XGetAtomNames(gdk_x11_get_default_xdisplay(), missing, n, found);
+		devilspie2_error_trap_pop();
+
+		for (i = 0; i < n; ++i) {
+			names[where[i]] = g_strdup(found[i] ? found[i] : "");
+			if (found[i])
+				XFree(found[i]);
+		}
+		g_free(found);
+	}
+
+	g_free(missing);
+	g_free(where);
+	return names;
+}
+
+
+/**
+ * The caller should trap errors; see also batch_set_decorated().
+ */
+void set_window_decorations(Window xid /*WnckWindow *window*/, gboolean decorate)
+{
+#define PROP_MOTIF_WM_HINTS_ELEMENTS 5
+#define MWM_HINTS_DECORATIONS (1L << 1)
+	struct {
+		unsigned long flags;
+		unsigned long functions;
+		unsigned long decorations;
+		long inputMode;
+		unsigned long status;
+	} hints = {0,};
+
+	hints.flags = MWM_HINTS_DECORATIONS;
+	hints.decorations = decorate ? 1 : 0;
+
+	/* Set Motif hints, most window managers handle these */
+	property_cache_forget(xid, atom_get(ATOM__MOTIF_WM_HINTS));
+	XChangeProperty(gdk_x11_get_default_xdisplay(), xid /*wnck_window_get_xid (window)*/,
+	                atom_get(ATOM__MOTIF_WM_HINTS),
+	                atom_get(ATOM__MOTIF_WM_HINTS), 32, PropModeReplace,
+	                (unsigned char *)&hints, PROP_MOTIF_WM_HINTS_ELEMENTS);
+
+
+	/* Apart from OpenBox, which doesn't respect it changing after mapping.
+	 * Instead it has this workaround.
+	 */
+	devilspie2_change_state (devilspie2_window_get_xscreen(xid),
+	                         xid /*wnck_window_get_xid(window)*/, !decorate,
+	                         atom_get(ATOM__OB_WM_STATE_UNDECORATED), 0);
+
+}
+
+
 /**
  *
  */
 gboolean get_decorated(Window xid /*WnckWindow *window*/)
 {
-	Display *disp = gdk_x11_get_default_xdisplay();
-	Atom type_ret;
-	Atom hints_atom = XInternAtom(disp, "_MOTIF_WM_HINTS", False);
-	int format_ret;
-	int err, result = 0;
-	unsigned long nitems_ret, bytes_after_ret, *prop_ret;
+	Atom hints_atom = atom_get(ATOM__MOTIF_WM_HINTS);
+	struct raw_property scratch;
+	const struct raw_property *prop = get_raw_property(xid, hints_atom, &scratch);
+	gboolean result = FALSE;
 
-	devilspie2_error_trap_push();
-	XGetWindowProperty(disp, xid, hints_atom, 0,
-	                PROP_MOTIF_WM_HINTS_ELEMENTS, 0, hints_atom,
-	                &type_ret, &format_ret, &nitems_ret,
-	                &bytes_after_ret, (unsigned char **)&prop_ret);
+	if (prop->ok)
+		result = prop->type != hints_atom || prop->format != 32 || prop->nitems < 3 ||
+		         ((unsigned long *)prop->data)[2] != 0;
 
-	err = devilspie2_error_trap_pop ();
-	if (err != Success || result != Success)
-		return FALSE;
-
-	return type_ret != hints_atom || nitems_ret < 3 || prop_ret[2] != 0;
+	release_raw_property(prop, &scratch);
+	return result;
 }
 
 
@@ -249,10 +868,16 @@ gboolean get_decorated(Window xid /*WnckWindow *window*/)
  */
 Screen *devilspie2_window_get_xscreen(Window xid)
 {
+	struct window_state *state = find_window_state(xid);
 	XWindowAttributes attrs;
 
+	if (state && state->screen)
+		return state->screen;
+
 	XGetWindowAttributes(gdk_x11_get_default_xdisplay(), xid, &attrs);
 
+	if (state)
+		state->screen = attrs.screen;
 	return attrs.screen;
 }
 
@@ -262,12 +887,12 @@ Screen *devilspie2_window_get_xscreen(Window xid)
  */
 char* my_wnck_get_string_property(Window xwindow, Atom atom, gboolean *utf8)
 {
+	struct raw_property scratch;
+	const struct raw_property *prop;
 	Atom type;
-	int format;
 	gulong nitems;
-	gulong bytes_after;
+	int format;
 	unsigned char *property;
-	int err, result;
 	char *retval;
 	Atom XA_UTF8_STRING;
 	gboolean is_utf8 = True;
@@ -275,24 +900,19 @@ char* my_wnck_get_string_property(Window xwindow, Atom atom, gboolean *utf8)
 	if (utf8)
 		*utf8 = False;
 
-	devilspie2_error_trap_push();
-	property = NULL;
-	result = XGetWindowProperty (gdk_x11_get_default_xdisplay (),
-	                             xwindow, atom,
-	                             0, G_MAXLONG,
-	                             False, AnyPropertyType, &type,
-	                             &format, &nitems,
-	                             &bytes_after, &property);
-
-	err = devilspie2_error_trap_pop ();
-	if (err != Success || result != Success)
+	prop = get_raw_property(xwindow, atom, &scratch);
+	if (!prop->ok) {
+		release_raw_property(prop, &scratch);
 		return NULL;
+	}
 
-	retval = NULL;
-	XA_UTF8_STRING = XInternAtom(gdk_x11_get_default_xdisplay(), "UTF8_STRING", False);
+	type = prop->type;
+	format = prop->format;
+	nitems = prop->nitems;
+	property = prop->data;
 
-	if (utf8)
-		*utf8 = False;
+	retval = NULL;
+	XA_UTF8_STRING = atom_get(ATOM_UTF8_STRING);
 
 	if (type == XA_STRING) {
 		is_utf8 = False;
@@ -300,32 +920,11 @@ char* my_wnck_get_string_property(Window xwindow, Atom atom, gboolean *utf8)
 	} else if (type == XA_UTF8_STRING) {
 		retval = g_strdup ((char*)property);
 	} else if (type == XA_ATOM && nitems > 0 && format == 32) {
-		long *pp;
-
-		pp = (long *)property; // we can assume (long *) since format == 32
-		if (nitems == 1) {
-			char* prop_name;
-			prop_name = XGetAtomName (gdk_x11_get_default_xdisplay (), *pp);
-			if (prop_name) {
-				retval = g_strdup (prop_name);
-				XFree (prop_name);
-			}
-		} else {
-			gulong i;
-			char** prop_names;
-
-			prop_names = g_new (char *, nitems + 1);
-			prop_names[nitems] = NULL;
-			for (i=0; i < nitems; i++) {
-				prop_names[i] = XGetAtomName (gdk_x11_get_default_xdisplay (),
-				                              *pp++);
-			}
-			retval = g_strjoinv (", ", prop_names);
-			for (i=0; i < nitems; i++) {
-				if (prop_names[i]) XFree (prop_names[i]);
-			}
-			g_free (prop_names);
-		}
+		// we can assume (Atom *) since format == 32
+		gchar **prop_names = get_atom_names((Atom *)property, nitems);
+
+		retval = g_strjoinv (", ", prop_names);
+		g_strfreev (prop_names);
 	} else if (type == XA_CARDINAL && nitems == 1) {
 		switch(format) {
 		case 32:
@@ -345,7 +944,7 @@ char* my_wnck_get_string_property(Window xwindow, Atom atom, gboolean *utf8)
 		retval = g_strdup_printf("%lu", (gulong) *(Window *)property);
 	}
 
-	XFree (property);
+	release_raw_property(prop, &scratch);
 	if (utf8)
 		*utf8 = is_utf8;
 	return retval;
@@ -357,13 +956,9 @@ char* my_wnck_get_string_property(Window xwindow, Atom atom, gboolean *utf8)
  */
 void my_wnck_set_string_property(Window xwindow, Atom atom, const gchar *const string, gboolean utf8)
 {
-	const unsigned char *const str = (const unsigned char *)string;
-	Display *display = gdk_x11_get_default_xdisplay();
-	Atom type = utf8 ? XInternAtom(display, "UTF8_STRING", False) : XA_STRING;
+	Atom type = utf8 ? atom_get(ATOM_UTF8_STRING) : XA_STRING;
 
-	devilspie2_error_trap_push();
-	XChangeProperty (display, xwindow, atom, type, 8, PropModeReplace, str, strlen(string));
-	devilspie2_error_trap_pop ();
+	batch_change_property(xwindow, atom, type, 8, string, strlen(string));
 }
 
 
@@ -372,11 +967,9 @@ void my_wnck_set_string_property(Window xwindow, Atom atom, const gchar *const s
  */
 void my_wnck_set_cardinal_property(Window xwindow, Atom atom, int32_t value)
 {
-	devilspie2_error_trap_push();
-	XChangeProperty (gdk_x11_get_default_xdisplay (),
-	                 xwindow, atom, XA_CARDINAL, 32,
-	                 PropModeReplace, (unsigned char *)&value, 1);
-	devilspie2_error_trap_pop ();
+	long data = value;	// format 32 data is passed as longs
+
+	batch_change_property(xwindow, atom, XA_CARDINAL, 32, &data, 1);
 }
 
 
@@ -385,9 +978,7 @@ void my_wnck_set_cardinal_property(Window xwindow, Atom atom, int32_t value)
  */
 void my_wnck_delete_property(Window xwindow, Atom atom)
 {
-	devilspie2_error_trap_push();
-	XDeleteProperty (gdk_x11_get_default_xdisplay (), xwindow, atom);
-	devilspie2_error_trap_pop ();
+	batch_delete_property(xwindow, atom);
 }
 
 
@@ -398,40 +989,24 @@ gboolean
 my_wnck_get_cardinal_list (Window xwindow, Atom atom,
                            gulong **cardinals, int *len)
 {
-	Atom type;
-	int format;
-	gulong nitems;
-	gulong bytes_after;
-	gulong *nums;
-	int err, result;
+	struct raw_property scratch;
+	const struct raw_property *prop;
 
 	*cardinals = NULL;
 	*len = 0;
 
-	devilspie2_error_trap_push();
-	type = None;
-	result = XGetWindowProperty(gdk_x11_get_default_xdisplay (),
-	                            xwindow,
-	                            atom,
-	                            0, G_MAXLONG,
-	                            False, XA_CARDINAL, &type, &format, &nitems,
-	                            &bytes_after, (void*)&nums);
+	prop = get_raw_property(xwindow, atom, &scratch);
 
-	err = devilspie2_error_trap_pop();
-
-	if ((err != Success) || (result != Success))
-		return FALSE;
-
-	if (type != XA_CARDINAL) {
-		XFree (nums);
+	if (!prop->ok || prop->type != XA_CARDINAL || prop->format != 32) {
+		release_raw_property(prop, &scratch);
 		return FALSE;
 	}
 
-	*cardinals = g_new(gulong, nitems);
-	memcpy(*cardinals, nums, sizeof (gulong) * nitems);
-	*len = nitems;
+	*cardinals = g_new(gulong, prop->nitems);
+	memcpy(*cardinals, prop->data, sizeof (gulong) * prop->nitems);
+	*len = prop->nitems;
 
-	XFree(nums);
+	release_raw_property(prop, &scratch);
 
 	return TRUE;
 }
@@ -449,7 +1024,7 @@ int devilspie2_get_viewport_start(Window xid, int *x, int *y)
 	int result = -1;
 
 	my_wnck_get_cardinal_list(RootWindowOfScreen(devilspie2_window_get_xscreen(xid)),
-	                          my_wnck_atom_get("_NET_DESKTOP_VIEWPORT"),
+	                          atom_get(ATOM__NET_DESKTOP_VIEWPORT),
 	                          &list, &len);
 
 	if (len > 0) {
@@ -470,60 +1045,35 @@ int devilspie2_get_viewport_start(Window xid, int *x, int *y)
  */
 void my_window_set_window_type(Window xid, gchar *window_type)
 {
-	Display *display = gdk_x11_get_default_xdisplay();
-
-	Atom atoms[10];
-
-	/*
-	_NET_WM_WINDOW_TYPE_DESKTOP, ATOM
-	_NET_WM_WINDOW_TYPE_DOCK, ATOM
-	_NET_WM_WINDOW_TYPE_TOOLBAR, ATOM
-	_NET_WM_WINDOW_TYPE_MENU, ATOM
-	_NET_WM_WINDOW_TYPE_UTILITY, ATOM
-	_NET_WM_WINDOW_TYPE_SPLASH, ATOM
-	_NET_WM_WINDOW_TYPE_DIALOG, ATOM
-	_NET_WM_WINDOW_TYPE_NORMAL, ATOM
-	*/
-
-	gchar *type = NULL;
+	static const struct {
+		const char *name;
+		enum atom_id atom;
+	} types[] = {
+		{ "WINDOW_TYPE_DESKTOP", ATOM__NET_WM_WINDOW_TYPE_DESKTOP },
+		{ "WINDOW_TYPE_DOCK", ATOM__NET_WM_WINDOW_TYPE_DOCK },
+		{ "WINDOW_TYPE_TOOLBAR", ATOM__NET_WM_WINDOW_TYPE_TOOLBAR },
+		{ "WINDOW_TYPE_MENU", ATOM__NET_WM_WINDOW_TYPE_MENU },
+		{ "WINDOW_TYPE_UTILITY", ATOM__NET_WM_WINDOW_TYPE_UTILITY },
+		{ "WINDOW_TYPE_SPLASH", ATOM__NET_WM_WINDOW_TYPE_SPLASH },
+		{ "WINDOW_TYPE_DIALOG", ATOM__NET_WM_WINDOW_TYPE_DIALOG },
+		{ "WINDOW_TYPE_NORMAL", ATOM__NET_WM_WINDOW_TYPE_NORMAL },
+	};
+	Atom type = None;
+	guint i;
 
 	//	Make it a recognized _NET_WM_TYPE
-
-	if (g_ascii_strcasecmp(window_type, "WINDOW_TYPE_DESKTOP") == 0) {
-		type = g_strdup("_NET_WM_WINDOW_TYPE_DESKTOP");
-
-	} else if (g_ascii_strcasecmp(window_type, "WINDOW_TYPE_DOCK") == 0) {
-		type = g_strdup("_NET_WM_WINDOW_TYPE_DOCK");
-
-	} else if (g_ascii_strcasecmp(window_type, "WINDOW_TYPE_TOOLBAR") == 0) {
-		type = g_strdup("_NET_WM_WINDOW_TYPE_TOOLBAR");
-
-	} else if (g_ascii_strcasecmp(window_type, "WINDOW_TYPE_MENU") == 0) {
-		type = g_strdup("_NET_WM_WINDOW_TYPE_MENU");
-
-	} else if (g_ascii_strcasecmp(window_type, "WINDOW_TYPE_UTILITY") == 0) {
-		type = g_strdup("_NET_WM_WINDOW_TYPE_UTILITY");
-
-	} else if (g_ascii_strcasecmp(window_type, "WINDOW_TYPE_SPLASH") == 0) {
-		type = g_strdup("_NET_WM_WINDOW_TYPE_SPLASH");
-
-	} else if (g_ascii_strcasecmp(window_type, "WINDOW_TYPE_DIALOG") == 0) {
-		type = g_strdup("_NET_WM_WINDOW_TYPE_DIALOG");
-
-	} else if (g_ascii_strcasecmp(window_type, "WINDOW_TYPE_NORMAL") == 0) {
-		type = g_strdup("_NET_WM_WINDOW_TYPE_NORMAL");
-
-	} else {
-		type = g_strdup(window_type);
+	for (i = 0; i < G_N_ELEMENTS(types); ++i) {
+		if (g_ascii_strcasecmp(window_type, types[i].name) == 0) {
+			type = atom_get(types[i].atom);
+			break;
+		}
 	}
 
-	atoms[0] = XInternAtom(display, type, False);
-
-	XChangeProperty(gdk_x11_get_default_xdisplay(), xid,
-	                XInternAtom(display, "_NET_WM_WINDOW_TYPE", False), XA_ATOM, 32,
-	                PropModeReplace, (unsigned char *) &atoms, 1);
+	// else take it as an atom name
+	if (type == None)
+		type = my_wnck_atom_get(window_type);
 
-	g_free(type);
+	batch_change_property(xid, atom_get(ATOM__NET_WM_WINDOW_TYPE), XA_ATOM, 32, &type, 1);
 }
 
 
@@ -532,16 +1082,9 @@ void my_window_set_window_type(Window xid, gchar *window_type)
  */
 void my_window_set_opacity(Window xid, double value)
 {
-	Display *display = gdk_x11_get_default_xdisplay();
-
-	unsigned int opacity = (uint)(0xffffffff * value);
-	Atom atom_net_wm_opacity = XInternAtom(display, "_NET_WM_WINDOW_OPACITY", False);
-
-
-	XChangeProperty(gdk_x11_get_default_xdisplay(), xid,
-	                atom_net_wm_opacity, XA_CARDINAL, 32,
-	                PropModeReplace, (unsigned char *) &opacity, 1L);
+	unsigned long opacity = (uint)(0xffffffff * value);
 
+	batch_change_property(xid, atom_get(ATOM__NET_WM_WINDOW_OPACITY), XA_CARDINAL, 32, &opacity, 1);
 }
 
 
@@ -589,35 +1132,139 @@ void set_window_geometry(WnckWindow *window, int x, int y, int w, int h, gboolea
 		if (adjusting_for_decoration)
 			adjust_for_decoration(window, &x, &y, &w, &h);
 
-		wnck_window_set_geometry(window,
-		                         gravity,
-		                         WNCK_WINDOW_CHANGE_X +
-		                         WNCK_WINDOW_CHANGE_Y +
-		                         WNCK_WINDOW_CHANGE_WIDTH +
-		                         WNCK_WINDOW_CHANGE_HEIGHT,
-		                         x, y, w, h);
+		batch_set_geometry(window,
+		                   gravity,
+		                   WNCK_WINDOW_CHANGE_X +
+		                   WNCK_WINDOW_CHANGE_Y +
+		                   WNCK_WINDOW_CHANGE_WIDTH +
+		                   WNCK_WINDOW_CHANGE_HEIGHT,
+		                   x, y, w, h);
 	}
 
 }
 
 
 /**
- *
+ * Monitor layout cache.
+ * Built from Xinerama on first use and thrown away when GDK reports that
+ * the monitor configuration has changed (it listens for RandR events).
  */
-int get_monitor_count(void)
+static GdkRectangle *monitors = NULL;
+static int monitor_count = -1; // not yet known
+static int primary_monitor = 0;
+
+
+static void monitors_changed_cb(GdkScreen *screen G_GNUC_UNUSED, gpointer data G_GNUC_UNUSED)
 {
-	// FIXME: retrieve monitor count via wnck
-	// For now, use Xinerama directly
-	Display *dpy = gdk_x11_get_default_xdisplay();
+	monitor_count = -1;
+}
+
+
+#ifdef HAVE_XRANDR
+/**
+ * Find which of our monitors is RandR's primary output; 0 if none is set.
+ */
+static int find_primary_monitor(Display *dpy)
+{
+	Window root = DefaultRootWindow(dpy);
+	RROutput output = XRRGetOutputPrimary(dpy, root);
+	int primary = 0;
 
-	if (!XineramaIsActive(dpy))
+	if (output == None)
 		return 0;
 
-	// Normally, we'd use the return value, but we only want the number of entries
-	int monitor_count = 0;
-	XineramaQueryScreens(dpy, &monitor_count);
+	XRRScreenResources *resources = XRRGetScreenResourcesCurrent(dpy, root);
+	if (!resources)
+		return 0;
+
+	XRROutputInfo *output_info = XRRGetOutputInfo(dpy, resources, output);
+	if (output_info && output_info->crtc) {
+		XRRCrtcInfo *crtc = XRRGetCrtcInfo(dpy, resources, output_info->crtc);
+		if (crtc) {
+			for (int i = 0; i < monitor_count; ++i) {
+				if (monitors[i].x == crtc->x && monitors[i].y == crtc->y &&
+				    monitors[i].width == (int)crtc->width &&
+				    monitors[i].height == (int)crtc->height) {
+					primary = i;
+					break;
+				}
+			}
+			XRRFreeCrtcInfo(crtc);
+		}
+	}
+	if (output_info)
+		XRRFreeOutputInfo(output_info);
+	XRRFreeScreenResources(resources);
 
-	return monitor_count;
+	return primary;
+}
+#endif
+
+
+/**
+ * Returns the list of monitor rectangles (NULL if there are none) and
+ * sets count and (if non-NULL) primary. The list remains valid until the
+ * monitor configuration changes.
+ */
+const GdkRectangle *get_monitors(int *count, int *primary)
+{
+	static gboolean connected = FALSE;
+
+	if (!connected) {
+		g_signal_connect(gdk_screen_get_default(), "monitors-changed",
+		                 G_CALLBACK(monitors_changed_cb), NULL);
+		connected = TRUE;
+	}
+
+	if (monitor_count < 0) {
+		// FIXME: retrieve monitor info via wnck
+		// For now, use Xinerama directly
+		Display *dpy = gdk_x11_get_default_xdisplay();
+		XineramaScreenInfo *monitor_list = NULL;
+		int n = 0;
+
+		if (XineramaIsActive(dpy))
+			monitor_list = XineramaQueryScreens(dpy, &n);
+
+		g_free(monitors);
+		monitors = NULL;
+		monitor_count = 0;
+		primary_monitor = 0;
+
+		if (monitor_list) {
+			monitors = g_new(GdkRectangle, n);
+			for (int i = 0; i < n; ++i) {
+				monitors[i].x = monitor_list[i].x_org;
+				monitors[i].y = monitor_list[i].y_org;
+				monitors[i].width = monitor_list[i].width;
+				monitors[i].height = monitor_list[i].height;
+			}
+			monitor_count = n;
+			XFree(monitor_list);
+		}
+
+#ifdef HAVE_XRANDR
+		if (monitor_count)
+			primary_monitor = find_primary_monitor(dpy);
+#endif
+	}
+
+	*count = monitor_count;
+	if (primary)
+		*primary = primary_monitor;
+	return monitor_count ? monitors : NULL;
+}
+
+
+/**
+ *
+ */
+int get_monitor_count(void)
+{
+	int count;
+
+	get_monitors(&count, NULL);
+	return count;
 }
 
 
@@ -628,18 +1275,12 @@ int get_monitor_index_geometry(WnckWindow *window, const GdkRectangle *window_r_
 {
 	// monitor_r is always filled in unless the return value is -1
 
-	// FIXME: retrieve monitor info via wnck
-	// For now, use Xinerama directly
 	int id = -1;
-	int monitor_count = 0;
-	XineramaScreenInfo *monitor_list = NULL;
-	Display *dpy = gdk_x11_get_default_xdisplay();
-
-	if (XineramaIsActive(dpy))
-		monitor_list = XineramaQueryScreens(dpy, &monitor_count);
+	int count, primary;
+	const GdkRectangle *monitor_list = get_monitors(&count, &primary);
 
 	// bail out if no Xinermama or no monitors
-	if (!monitor_list || !monitor_count)
+	if (!monitor_list)
 		return -1;
 
 	// find which monitor the window's centre is on
@@ -651,11 +1292,11 @@ int get_monitor_index_geometry(WnckWindow *window, const GdkRectangle *window_r_
 
 	GdkPoint centre = { window_r.x + window_r.width / 2, window_r.y + window_r.height / 2 };
 
-	for (int i = 0; i < monitor_count; ++i) {
-		if (centre.x >= monitor_list[i].x_org &&
-		    centre.x <  monitor_list[i].x_org + monitor_list[i].width &&
-		    centre.y >= monitor_list[i].y_org &&
-		    centre.y <  monitor_list[i].y_org + monitor_list[i].height) {
+	for (int i = 0; i < count; ++i) {
+		if (centre.x >= monitor_list[i].x &&
+		    centre.x <  monitor_list[i].x + monitor_list[i].width &&
+		    centre.y >= monitor_list[i].y &&
+		    centre.y <  monitor_list[i].y + monitor_list[i].height) {
 			id = i;
 			break;
 		}
@@ -665,29 +1306,20 @@ int get_monitor_index_geometry(WnckWindow *window, const GdkRectangle *window_r_
 	// just use the first matching
 	// FIXME?: should find whichever shows most of the window (if tied, closest to window centre)
 	if (id < 0) {
-		for (int i = 0; i < monitor_count; ++i) {
-			GdkRectangle r = {
-				monitor_list[i].x_org, monitor_list[i].y_org,
-				monitor_list[i].x_org + monitor_list[i].width,
-				monitor_list[i].y_org + monitor_list[i].height
-			};
-			if (gdk_rectangle_intersect(&window_r, &r, NULL)) {
+		for (int i = 0; i < count; ++i) {
+			if (gdk_rectangle_intersect(&window_r, &monitor_list[i], NULL)) {
 				id = i;
 				break;
 			}
 		}
 	}
 
-	// and if that too fails, use the default
+	// and if that too fails, use the primary monitor
 	if (id < 0)
-		id = 0; // FIXME: primary monitor
+		id = primary;
 
-	if (monitor_r) {
-		monitor_r->x = monitor_list[id].x_org;
-		monitor_r->y = monitor_list[id].y_org;
-		monitor_r->width = monitor_list[id].width;
-		monitor_r->height = monitor_list[id].height;
-	}
+	if (monitor_r)
+		*monitor_r = monitor_list[id];
 
 	return id;
 }
@@ -698,30 +1330,20 @@ int get_monitor_index_geometry(WnckWindow *window, const GdkRectangle *window_r_
  */
 int get_monitor_geometry(int index, GdkRectangle *monitor_r)
 {
-	// if out of range, output is for monitor 0 (if present) else this:
+	// if out of range, output is for the primary monitor (if present) else this:
 	*monitor_r = (GdkRectangle){ 0, 0, 640, 480 };
 
-	// FIXME: retrieve monitor info via wnck
-	// For now, use Xinerama directly
-	int monitor_count = 0;
-	XineramaScreenInfo *monitor_list = NULL;
-	Display *dpy = gdk_x11_get_default_xdisplay();
-
-	if (XineramaIsActive(dpy))
-		monitor_list = XineramaQueryScreens(dpy, &monitor_count);
+	int count, primary;
+	const GdkRectangle *monitor_list = get_monitors(&count, &primary);
 
 	// bail out if no Xinermama or no monitors
-	if (!monitor_list || !monitor_count)
+	if (!monitor_list)
 		return -1; // no xinerama!
 
-	// FIXME: default to primary monitor
-	if (index < 0 || index >= monitor_count)
-		index = 0;
+	if (index < 0 || index >= count)
+		index = primary;
 
-	monitor_r->x = monitor_list[index].x_org;
-	monitor_r->y = monitor_list[index].y_org;
-	monitor_r->width = monitor_list[index].width;
-	monitor_r->height = monitor_list[index].height;
+	*monitor_r = monitor_list[index];
 
 	return index;
 }
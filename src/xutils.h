@@ -32,8 +32,54 @@
 #define MONITOR_WINDOW  -1 /* Monitor no. 0 (current monitor) */
 
 /**
- *
+ * The atoms which devilspie2 itself uses, named ATOM_<atom name>.
+ * They are all interned together, in one round trip, the first time that
+ * any of them is needed; my_wnck_atom_get() is for other names (those
+ * which scripts supply).
  */
+#define DEVILSPIE2_ATOMS(A) \
+	A(UTF8_STRING) \
+	A(WM_CLASS) \
+	A(WM_NAME) \
+	A(WM_WINDOW_ROLE) \
+	A(_NET_WM_NAME) \
+	A(_NET_WM_PID) \
+	A(_NET_WM_STATE) \
+	A(_NET_WM_WINDOW_TYPE) \
+	A(_NET_WM_WINDOW_TYPE_DESKTOP) \
+	A(_NET_WM_WINDOW_TYPE_DOCK) \
+	A(_NET_WM_WINDOW_TYPE_TOOLBAR) \
+	A(_NET_WM_WINDOW_TYPE_MENU) \
+	A(_NET_WM_WINDOW_TYPE_UTILITY) \
+	A(_NET_WM_WINDOW_TYPE_SPLASH) \
+	A(_NET_WM_WINDOW_TYPE_DIALOG) \
+	A(_NET_WM_WINDOW_TYPE_NORMAL) \
+	A(_NET_WM_WINDOW_OPACITY) \
+	A(_NET_WM_STRUT) \
+	A(_NET_WM_STRUT_PARTIAL) \
+	A(_NET_FRAME_EXTENTS) \
+	A(_NET_DESKTOP_VIEWPORT) \
+	A(_MOTIF_WM_HINTS) \
+	A(_OB_WM_STATE_UNDECORATED) \
+	A(_DEVILSPIE2_TIMESTAMP)
+
+#define DEVILSPIE2_ATOM_ID(name) ATOM_##name,
+enum atom_id {
+	DEVILSPIE2_ATOMS(DEVILSPIE2_ATOM_ID)
+	ATOM_COUNT
+};
+#undef DEVILSPIE2_ATOM_ID
+
+Atom atom_get(enum atom_id id);
+
+void xutils_init(void);
+
+/**
+ * The wnck handle whose screens devilspie2 watches; windows are looked up
+ * (by XID) through it, not through wnck's deprecated default handle.
+ */
+extern WnckHandle *my_wnck_handle;
+
 Atom my_wnck_atom_get(const char *atom_name);
 
 void devilspie2_change_state(Screen *screen,
@@ -46,11 +92,37 @@ Screen* devilspie2_window_get_xscreen(Window xid);
 
 void devilspie2_error_trap_push();
 int devilspie2_error_trap_pop();
+void devilspie2_error_trap_pop_ignored();
 
-gboolean decorate_window(Window xid);
-gboolean undecorate_window(Window xid);
+void set_window_decorations(Window xid, gboolean decorate);
 gboolean get_decorated(Window xid);
 
+Time devilspie2_get_server_time(void);
+
+void window_state_track(Window xid);
+void window_state_forget(Window xid);
+
+/**
+ * A property as read from the X server.
+ */
+struct raw_property {
+	gboolean ok;	// FALSE if the read failed (e.g. bad window)
+	Atom type;
+	int format;
+	gulong nitems;
+	gulong bytes_after;
+	guchar *data;	// as returned by Xlib (format 32 => longs), NUL-terminated
+};
+
+gboolean get_window_property_data(Window xwindow, Atom atom, Atom req_type, gulong max_bytes,
+                                  struct raw_property *prop);
+gchar **get_atom_names(const Atom *atoms, int count);
+
+void property_cache_begin(Window xid);
+void property_cache_end(void);
+void property_cache_forget(Window xid, Atom atom);
+void property_cache_prefetch(Window xid);
+
 char* my_wnck_get_string_property(Window xwindow, Atom atom, gboolean *utf8) ATTR_MALLOC;
 void my_wnck_set_string_property(Window xwindow, Atom atom, const gchar *const value, gboolean utf8);
 void my_wnck_set_cardinal_property (Window xwindow, Atom atom, int32_t value);
@@ -69,6 +141,7 @@ void my_window_set_opacity(Window xid, double value);
 void adjust_for_decoration(WnckWindow *window, int *x, int *y, int *w, int *h);
 void set_window_geometry(WnckWindow *window, int x, int y, int w, int h, gboolean adjust_for_decoration);
 
+const GdkRectangle *get_monitors(int *count, int *primary);
 int get_monitor_count(void);
 int get_monitor_index_geometry(WnckWindow *window, const GdkRectangle *window_r, /*out*/ GdkRectangle *monitor_r);
 int get_monitor_geometry(int index, /*out*/ GdkRectangle *monitor_r);
@@ -0,0 +1,70 @@
+#!/bin/sh
+#
+# This file is part of devilspie2
+# Copyright (C) 2026 devilspie2 developers
+#
+# devilspie2 is free software: you can redistribute it and/or
+# modify it under the terms of the GNU General Public License as published
+# by the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# devilspie2 is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with devilspie2.
+# If not, see <http://www.gnu.org/licenses/>.
+#
+
+# Runs the window tests under Xvfb.
+#
+# Environment:
+#   DEVILSPIE2       the binary to test (default: bin/devilspie2)
+#   TEST_WINDOW_OPS  the helper (default: bin/test-window-ops)
+#   TEST_DISPLAY     display for Xvfb (default: :98)
+
+set -e
+
+DEVILSPIE2=${DEVILSPIE2:-bin/devilspie2}
+TEST_WINDOW_OPS=${TEST_WINDOW_OPS:-bin/test-window-ops}
+TEST_DISPLAY=${TEST_DISPLAY:-:98}
+
+if ! command -v Xvfb >/dev/null; then
+	echo 'check: Xvfb not found' >&2
+	exit 1
+fi
+
+WORKDIR=$(mktemp -d)
+XVFB_PID=
+
+cleanup() {
+	test -z "$XVFB_PID" || kill "$XVFB_PID" 2>/dev/null || :
+	rm -rf -- "$WORKDIR"
+}
+trap cleanup EXIT INT TERM
+
+Xvfb "$TEST_DISPLAY" -screen 0 1280x1024x24 -nolisten tcp >/dev/null 2>&1 &
+XVFB_PID=$!
+DISPLAY=$TEST_DISPLAY
+export DISPLAY
+
+# wait for the server to come up
+i=0
+until xdpyinfo >/dev/null 2>&1 || test -S "/tmp/.X11-unix/X${TEST_DISPLAY#:}"; do
+	i=$((i + 1))
+	if test $i -gt 50; then
+		echo 'check: Xvfb did not start' >&2
+		exit 1
+	fi
+	sleep 0.1
+done
+
+# keep the daemon's cache etc. out of the user's home
+XDG_CACHE_HOME=$WORKDIR/cache
+XDG_CONFIG_HOME=$WORKDIR/config
+XDG_RUNTIME_DIR=$WORKDIR
+export XDG_CACHE_HOME XDG_CONFIG_HOME XDG_RUNTIME_DIR
+
+"$TEST_WINDOW_OPS" -- "$DEVILSPIE2"
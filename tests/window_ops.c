@@ -0,0 +1,766 @@
+/**
+ *	This file is part of devilspie2
+ *	Copyright (C) 2026 devilspie2 developers
+ *
+ *	devilspie2 is free software: you can redistribute it and/or
+ *	modify it under the terms of the GNU General Public License as published
+ *	by the Free Software Foundation, either version 3 of the License, or
+ *	(at your option) any later version.
+ *
+ *	devilspie2 is distributed in the hope that it will be useful,
+ *	but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *	GNU General Public License for more details.
+ *
+ *	You should have received a copy of the GNU General Public License
+ *	along with devilspie2.
+ *	If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/**
+ * End-to-end test of window changes made by scripts; see tests/run.sh.
+ *
+ *   test-window-ops -- devilspie2 args...
+ *
+ * Acts as a minimal EWMH window manager, as bench-windows does, writes one
+ * script per test case to a temporary folder and starts the given
+ * devilspie2 command with --folder pointing there. For each case it then
+ * maps a window of class DP2Test<n>, whose script asks for a change, and
+ * waits for devilspie2 to ask the window manager for that change (a client
+ * message to the root window, which is how libwnck does it).
+ *
+ * Some cases also check that a property of the window was changed before
+ * the request arrived, i.e. that devilspie2 kept the script's order.
+ *
+ * Other cases look at what scripts can find out rather than at what they
+ * change: the script puts its findings in the DP2_RESULT property of its
+ * window, which must then match what was expected and stay that way for
+ * QUIET_MS. Such a case may first set up other windows (fixtures) which
+ * devilspie2 sees opened before the case's own. A script which has more to
+ * do later sets DP2_READY to "1" first, from which time is measured and
+ * after which the case may do something to the window, e.g. rename it.
+ *
+ * Prints one line per case; the exit status is 0 if all of them passed.
+ */
+
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+
+#define TIMEOUT_MS 5000
+#define STARTUP_TIMEOUT_MS 30000
+#define QUIET_MS 600
+#define EVENT_DELAY_MS 300	// for focus, blur and name changes; see write_scripts()
+
+#define MAX_CASES 16
+#define ALL_DESKTOPS 0xFFFFFFFFL
+
+static Display *dpy;
+static Window root;
+static Atom atom_client_list, atom_client_list_stacking;
+static Atom atom_moveresize, atom_state, atom_maximized_vert, atom_maximized_horz;
+static Atom atom_active_window, atom_ready, atom_result;
+
+static Window clients[32];	// as listed in _NET_CLIENT_LIST
+static int n_clients;
+static Window windows[MAX_CASES];	// each case's own window
+
+static char *last_result;	// for reporting failures
+
+
+/**
+ * What a case's script does, and how to recognise the request which it
+ * should lead to.
+ */
+struct test_case {
+	const char *name;
+	const char *script;	// run for the case's own window
+	int handler;	// the script defines handler functions and is run as it is
+	int target;	// the case whose window the request or result is for
+	int (*matches)(const XClientMessageEvent *ev);	// the request, if any
+	const char *property_before;	// if set, must change on the target first
+	const char *result;	// if set, what the script leaves in DP2_RESULT
+	void (*setup)(Window w);	// before the case's window is mapped
+	int min_ms;	// if set, the result may not come sooner after DP2_READY
+	int (*stimulus)(Window w);	// once DP2_READY is set; returns 0 on failure
+};
+
+
+/**
+ * Another window for a case to find.
+ */
+struct fixture {
+	const char *name;
+	const char *class;
+	const char *role;
+	long pid;
+	long desktop;	// from 0, or ALL_DESKTOPS
+};
+
+
+static int is_geometry(const XClientMessageEvent *ev, long x, long y, long w, long h)
+{
+	return ev->message_type == atom_moveresize &&
+	       ev->data.l[1] == x && ev->data.l[2] == y &&
+	       ev->data.l[3] == w && ev->data.l[4] == h;
+}
+
+
+static int geometry_set(const XClientMessageEvent *ev)
+{
+	return is_geometry(ev, 10, 20, 300, 200);
+}
+
+
+static int geometry_set_by_handle(const XClientMessageEvent *ev)
+{
+	return is_geometry(ev, 30, 40, 200, 100);
+}
+
+
+static int geometry_after_undecorating(const XClientMessageEvent *ev)
+{
+	return is_geometry(ev, 50, 60, 400, 300);
+}
+
+
+static int maximized(const XClientMessageEvent *ev)
+{
+	return ev->message_type == atom_state && ev->data.l[0] == 1 &&
+	       ((ev->data.l[1] == (long)atom_maximized_vert && ev->data.l[2] == (long)atom_maximized_horz) ||
+	        (ev->data.l[1] == (long)atom_maximized_horz && ev->data.l[2] == (long)atom_maximized_vert));
+}
+
+
+static void add_fixtures(const struct fixture *fixtures, int count);
+static int wait_for_value(Window w, Atom atom, const char *want, double deadline);
+static double now_ms(void);
+
+
+static const struct fixture find_fixtures[] = {
+	{ "find-a", "DP2Find", "alpha", 4242, 0 },
+	{ "find-b", "DP2Find", "beta", 4243, 1 },
+	{ "find-c", "DP2Find", "alpha", 4243, ALL_DESKTOPS },
+	{ "find-d", "DP2Other", "alpha", 4242, 1 },
+};
+
+
+static void find_setup(Window w)
+{
+	(void)w;
+	add_fixtures(find_fixtures, sizeof(find_fixtures) / sizeof(find_fixtures[0]));
+}
+
+
+/**
+ * Three names in quick succession, for one run of on_name_change, then the
+ * last of them again, for none.
+ */
+static int rename_quickly(Window w)
+{
+	XStoreName(dpy, w, "n1");
+	XFlush(dpy);
+	poll(NULL, 0, 30);
+	XStoreName(dpy, w, "n2");
+	XFlush(dpy);
+	poll(NULL, 0, 30);
+	XStoreName(dpy, w, "n3");
+	XFlush(dpy);
+
+	if (!wait_for_value(w, atom_result, "1 n3", now_ms() + TIMEOUT_MS))
+		return 0;
+
+	XStoreName(dpy, w, "n3");
+	XFlush(dpy);
+	return 1;
+}
+
+
+static const struct fixture focus_fixtures[] = {
+	{ "focus-other", "DP2Focus", NULL, 0, 0 },
+};
+
+static Window focus_other;
+
+
+static void focus_setup(Window w)
+{
+	(void)w;
+	add_fixtures(focus_fixtures, 1);
+	focus_other = clients[n_clients - 1];
+}
+
+
+static void activate(Window w)
+{
+	XChangeProperty(dpy, root, atom_active_window, XA_WINDOW, 32, PropModeReplace,
+	                (unsigned char *)&w, 1);
+	XFlush(dpy);
+}
+
+
+/**
+ * Focus the window; then, within the focus and blur delays, away and back,
+ * which should cancel out; then away for good.
+ */
+static int flip_focus(Window w)
+{
+	activate(w);
+	if (!wait_for_value(w, atom_result, "focus", now_ms() + TIMEOUT_MS))
+		return 0;
+
+	activate(focus_other);
+	poll(NULL, 0, 100);
+	activate(w);
+	poll(NULL, 0, 2 * EVENT_DELAY_MS);
+
+	activate(focus_other);
+	return 1;
+}
+
+
+/**
+ * Properties to be read in part.
+ */
+static void property_setup(Window w)
+{
+	static const char data[] = "0123456789abcdef";
+	static const long cards[] = { 1, 2, 3, 4, 5 };
+
+	XChangeProperty(dpy, w, XInternAtom(dpy, "DP2_DATA", False), XA_STRING, 8,
+	                PropModeReplace, (const unsigned char *)data, strlen(data));
+	XChangeProperty(dpy, w, XInternAtom(dpy, "DP2_CARDS", False), XA_CARDINAL, 32,
+	                PropModeReplace, (const unsigned char *)cards, 5);
+}
+
+
+static const struct test_case cases[] = {
+	{ .name = "batched geometry",
+	  .script = "set_window_geometry(10, 20, 300, 200)",
+	  .target = 0, .matches = geometry_set },
+	{ .name = "batched wnck call",
+	  .script = "maximize()",
+	  .target = 1, .matches = maximized },
+	{ .name = "window handle method",
+	  .script =
+	  "for _, w in ipairs(get_windows()) do\n"
+	  "\t\tif w:get_window_class() == \"DP2Test0\" then w:set_window_geometry(30, 40, 200, 100) end\n"
+	  "\tend",
+	  .target = 0, .matches = geometry_set_by_handle },
+	// the second undecorate_window() may only be merged with the first if
+	// that keeps the decorations ahead of the geometry
+	{ .name = "decorations before geometry",
+	  .script =
+	  "undecorate_window()\n"
+	  "\tset_window_geometry(50, 60, 400, 300)\n"
+	  "\tundecorate_window()",
+	  .target = 3, .matches = geometry_after_undecorating, .property_before = "_MOTIF_WM_HINTS" },
+	// names sorted, so that only the filters are tested; the pinned window
+	// is on every workspace
+	{ .name = "find_windows filters",
+	  .script =
+	  "local function names(query)\n"
+	  "\t\tlocal found = {}\n"
+	  "\t\tfor _, w in ipairs(find_windows(query)) do found[#found + 1] = w:get_window_name() end\n"
+	  "\t\ttable.sort(found)\n"
+	  "\t\treturn table.concat(found, \",\")\n"
+	  "\tend\n"
+	  "\tset_window_property(\"DP2_RESULT\", table.concat({\n"
+	  "\t\tnames{class = \"DP2Find\"},\n"
+	  "\t\tnames{role = \"alpha\"},\n"
+	  "\t\tnames{pid = 4243},\n"
+	  "\t\tnames{workspace = 2},\n"
+	  "\t\tnames{class = \"DP2Find\", workspace = 1},\n"
+	  "\t\tnames{class = \"DP2Find\", role = \"alpha\", pid = 4242},\n"
+	  "\t\tnames{class = \"DP2Nothing\"},\n"
+	  "\t}, \"|\"))",
+	  .target = 4, .setup = find_setup,
+	  .result = "find-a,find-b,find-c|find-a,find-c,find-d|find-b,find-c|find-b,find-c,find-d|"
+	            "find-a,find-c|find-a|" },
+	{ .name = "after() waits",
+	  .script =
+	  "set_window_property(\"DP2_READY\", \"1\")\n"
+	  "\tafter(400, function() set_window_property(\"DP2_RESULT\", \"later\") end)",
+	  .target = 5, .result = "later", .min_ms = 350 },
+	// an error, which ends the script
+	{ .name = "bare coroutine.yield()",
+	  .script =
+	  "set_window_property(\"DP2_RESULT\", \"before\")\n"
+	  "\tcoroutine.yield()\n"
+	  "\tset_window_property(\"DP2_RESULT\", \"after\")",
+	  .target = 6, .result = "before" },
+	{ .name = "name changes collapsed",
+	  .handler = 1,
+	  .script =
+	  "local count = 0\n"
+	  "function on_open()\n"
+	  "\tif get_window_class() == mine then set_window_property(\"DP2_READY\", \"1\") end\n"
+	  "end\n"
+	  "function on_name_change()\n"
+	  "\tif get_window_class() == mine then\n"
+	  "\t\tcount = count + 1\n"
+	  "\t\tset_window_property(\"DP2_RESULT\", count .. \" \" .. get_window_name())\n"
+	  "\tend\n"
+	  "end",
+	  .target = 7, .stimulus = rename_quickly, .result = "1 n3" },
+	{ .name = "focus and blur cancel out",
+	  .handler = 1,
+	  .script =
+	  "local events = {}\n"
+	  "local function note(event)\n"
+	  "\tif get_window_class() == mine then\n"
+	  "\t\tevents[#events + 1] = event\n"
+	  "\t\tset_window_property(\"DP2_RESULT\", table.concat(events, \",\"))\n"
+	  "\tend\n"
+	  "end\n"
+	  "function on_open()\n"
+	  "\tif get_window_class() == mine then set_window_property(\"DP2_READY\", \"1\") end\n"
+	  "end\n"
+	  "function on_focus() note(\"focus\") end\n"
+	  "function on_blur() note(\"blur\") end",
+	  .target = 8, .setup = focus_setup, .stimulus = flip_focus, .result = "focus,blur" },
+	// max_bytes is cut down to whole items; read from the server, then
+	// from the cache
+	{ .name = "property data max_bytes",
+	  .script =
+	  "local function describe(value, kind, rest)\n"
+	  "\t\tif type(value) == \"table\" then value = table.concat(value, \",\") end\n"
+	  "\t\treturn tostring(value) .. \" \" .. tostring(kind) .. \" \" .. tostring(rest)\n"
+	  "\tend\n"
+	  "\tlocal function read_all()\n"
+	  "\t\treturn table.concat({\n"
+	  "\t\t\tdescribe(get_window_property_data(\"DP2_DATA\", nil, 3)),\n"
+	  "\t\t\tdescribe(get_window_property_data(\"DP2_CARDS\", \"CARDINAL\", 6)),\n"
+	  "\t\t\tdescribe(get_window_property_data(\"DP2_DATA\", \"CARDINAL\")),\n"
+	  "\t\t}, \"; \")\n"
+	  "\tend\n"
+	  "\tlocal uncached = read_all()\n"
+	  "\tget_window_property(\"DP2_DATA\")\n"
+	  "\tget_window_property(\"DP2_CARDS\")\n"
+	  "\tset_window_property(\"DP2_RESULT\", uncached .. \"|\" .. read_all())",
+	  .target = 9, .setup = property_setup,
+	  .result = "012 STRING 13; 1 CARDINAL 16; nil STRING 16|"
+	            "012 STRING 13; 1 CARDINAL 16; nil STRING 16" },
+};
+
+#define N_CASES ((int)(sizeof(cases) / sizeof(cases[0])))
+
+
+static double now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+
+static void set_client_list(void)
+{
+	XChangeProperty(dpy, root, atom_client_list, XA_WINDOW, 32, PropModeReplace,
+	                (unsigned char *)clients, n_clients);
+	XChangeProperty(dpy, root, atom_client_list_stacking, XA_WINDOW, 32, PropModeReplace,
+	                (unsigned char *)clients, n_clients);
+	XFlush(dpy);
+}
+
+
+/**
+ * Just enough of a window manager for libwnck; unlike bench-windows we
+ * also listen for the requests which clients send to the window manager.
+ */
+static void become_wm(void)
+{
+	Window check = XCreateSimpleWindow(dpy, root, -1, -1, 1, 1, 0, 0, 0);
+	Atom utf8 = XInternAtom(dpy, "UTF8_STRING", False);
+	Atom supported[6];
+	long desktops = 2, desktop = 0;
+
+	XChangeProperty(dpy, check, XInternAtom(dpy, "_NET_SUPPORTING_WM_CHECK", False),
+	                XA_WINDOW, 32, PropModeReplace, (unsigned char *)&check, 1);
+	XChangeProperty(dpy, check, XInternAtom(dpy, "_NET_WM_NAME", False),
+	                utf8, 8, PropModeReplace, (unsigned char *)"test-wm", 7);
+	XChangeProperty(dpy, root, XInternAtom(dpy, "_NET_SUPPORTING_WM_CHECK", False),
+	                XA_WINDOW, 32, PropModeReplace, (unsigned char *)&check, 1);
+
+	supported[0] = atom_client_list;
+	supported[1] = atom_client_list_stacking;
+	supported[2] = XInternAtom(dpy, "_NET_NUMBER_OF_DESKTOPS", False);
+	supported[3] = XInternAtom(dpy, "_NET_CURRENT_DESKTOP", False);
+	supported[4] = XInternAtom(dpy, "_NET_WM_DESKTOP", False);
+	supported[5] = atom_active_window;
+	XChangeProperty(dpy, root, XInternAtom(dpy, "_NET_SUPPORTED", False),
+	                XA_ATOM, 32, PropModeReplace, (unsigned char *)supported, 6);
+	XChangeProperty(dpy, root, supported[2], XA_CARDINAL, 32, PropModeReplace,
+	                (unsigned char *)&desktops, 1);
+	XChangeProperty(dpy, root, supported[3], XA_CARDINAL, 32, PropModeReplace,
+	                (unsigned char *)&desktop, 1);
+
+	XSelectInput(dpy, root, SubstructureNotifyMask);
+	set_client_list();
+}
+
+
+/**
+ * Wait for the next event matching the predicate. Returns 0 on timeout.
+ */
+static int wait_for(int (*pred)(const XEvent *ev, const void *arg), const void *arg, double deadline)
+{
+	struct pollfd pfd = { ConnectionNumber(dpy), POLLIN, 0 };
+	XEvent ev;
+
+	for (;;) {
+		while (XPending(dpy)) {
+			XNextEvent(dpy, &ev);
+			if (pred(&ev, arg))
+				return 1;
+		}
+
+		double left = deadline - now_ms();
+		if (left <= 0)
+			return 0;
+		poll(&pfd, 1, (int)left + 1);
+	}
+}
+
+
+static int is_mapped(const XEvent *ev, const void *arg)
+{
+	return ev->type == MapNotify && ev->xmap.window == *(const Window *)arg;
+}
+
+
+static Atom property_before;
+static int property_seen;
+
+
+static int is_request(const XEvent *ev, const void *arg)
+{
+	const struct test_case *test = arg;
+
+	if (ev->type == PropertyNotify && ev->xproperty.window == windows[test->target] &&
+	    ev->xproperty.atom == property_before)
+		property_seen = 1;
+
+	return ev->type == ClientMessage &&
+	       ev->xclient.window == windows[test->target] &&
+	       test->matches(&ev->xclient);
+}
+
+
+/**
+ * Create the fixtures, unmapped (libwnck doesn't mind), and wait for
+ * devilspie2 to have seen them.
+ */
+static void add_fixtures(const struct fixture *fixtures, int count)
+{
+	for (int i = 0; i < count; ++i) {
+		const struct fixture *f = &fixtures[i];
+		Window w = XCreateSimpleWindow(dpy, root, 0, 0, 100, 100, 0, 0, 0);
+		XClassHint hint = { (char *)f->name, (char *)f->class };
+
+		XSetClassHint(dpy, w, &hint);
+		XStoreName(dpy, w, f->name);
+		if (f->role)
+			XChangeProperty(dpy, w, XInternAtom(dpy, "WM_WINDOW_ROLE", False),
+			                XA_STRING, 8, PropModeReplace,
+			                (unsigned char *)f->role, strlen(f->role));
+		if (f->pid)
+			XChangeProperty(dpy, w, XInternAtom(dpy, "_NET_WM_PID", False),
+			                XA_CARDINAL, 32, PropModeReplace, (unsigned char *)&f->pid, 1);
+		XChangeProperty(dpy, w, XInternAtom(dpy, "_NET_WM_DESKTOP", False),
+		                XA_CARDINAL, 32, PropModeReplace, (unsigned char *)&f->desktop, 1);
+		clients[n_clients++] = w;
+	}
+
+	set_client_list();
+	poll(NULL, 0, 300);
+}
+
+
+static char *get_string_property(Window w, Atom atom)
+{
+	Atom type;
+	int format;
+	unsigned long nitems, bytes_after;
+	unsigned char *data = NULL;
+	char *value = NULL;
+
+	if (XGetWindowProperty(dpy, w, atom, 0, 1024, False, AnyPropertyType, &type, &format,
+	                       &nitems, &bytes_after, &data) == Success &&
+	    data && format == 8)
+		value = strndup((char *)data, nitems);
+	if (data)
+		XFree(data);
+	return value;
+}
+
+
+struct property_wait {
+	Window window;
+	Atom atom;
+};
+
+
+static int is_property_change(const XEvent *ev, const void *arg)
+{
+	const struct property_wait *pw = arg;
+
+	return ev->type == PropertyNotify && ev->xproperty.window == pw->window &&
+	       ev->xproperty.atom == pw->atom;
+}
+
+
+/**
+ * Read a string property, keeping it in last_result; 1 if it is want.
+ */
+static int has_value(Window w, Atom atom, const char *want)
+{
+	free(last_result);
+	last_result = get_string_property(w, atom);
+	return last_result && strcmp(last_result, want) == 0;
+}
+
+
+/**
+ * Wait for a string property to be set to want. Returns 0 on timeout.
+ */
+static int wait_for_value(Window w, Atom atom, const char *want, double deadline)
+{
+	struct property_wait pw = { w, atom };
+
+	while (!has_value(w, atom, want))
+		if (!wait_for(is_property_change, &pw, deadline))
+			return 0;
+	return 1;
+}
+
+
+/**
+ * Check that a string property keeps the value want for ms. (Notifications
+ * of earlier changes may still be queued, so it's the value which counts.)
+ */
+static int stays_at_value(Window w, Atom atom, const char *want, int ms)
+{
+	struct property_wait pw = { w, atom };
+	double deadline = now_ms() + ms;
+
+	while (wait_for(is_property_change, &pw, deadline))
+		if (!has_value(w, atom, want))
+			return 0;
+	return 1;
+}
+
+
+/**
+ * Map the window for a case and wait for the request or the result.
+ * Returns 0 on timeout.
+ */
+static int run_case(int index, int timeout)
+{
+	const struct test_case *test = &cases[index];
+	char name[64], class[32];
+	XClassHint hint;
+	Window w;
+	double ready = 0;
+
+	snprintf(name, sizeof(name), "test window %d", index);
+	snprintf(class, sizeof(class), "DP2Test%d", index);
+	hint.res_name = name;
+	hint.res_class = class;
+
+	w = XCreateSimpleWindow(dpy, root, 0, 0, 200, 100, 0, 0, 0);
+	windows[index] = w;
+	XSetClassHint(dpy, w, &hint);
+	XStoreName(dpy, w, name);
+	XSelectInput(dpy, w, StructureNotifyMask | PropertyChangeMask);
+	if (test->setup)
+		test->setup(w);
+	XMapWindow(dpy, w);
+	XFlush(dpy);
+
+	if (!wait_for(is_mapped, &w, now_ms() + timeout))
+		return 0;
+
+	// this is what tells libwnck about the window
+	clients[n_clients++] = w;
+	set_client_list();
+
+	property_before = test->property_before ?
+	                  XInternAtom(dpy, test->property_before, False) : None;
+	property_seen = 0;
+
+	if (test->min_ms || test->stimulus) {
+		if (!wait_for_value(w, atom_ready, "1", now_ms() + timeout))
+			return 0;
+		ready = now_ms();
+		if (test->stimulus && !test->stimulus(w))
+			return 0;
+	}
+
+	if (test->matches) {
+		if (!wait_for(is_request, test, now_ms() + timeout))
+			return 0;
+		if (property_before && !property_seen)
+			return 0;
+	}
+
+	if (test->result) {
+		Window target = windows[test->target];
+
+		if (!wait_for_value(target, atom_result, test->result, now_ms() + timeout))
+			return 0;
+		if (test->min_ms && now_ms() - ready < test->min_ms) {
+			printf("\tDP2_RESULT came %.0f ms after DP2_READY\n", now_ms() - ready);
+			return 0;
+		}
+		if (!stays_at_value(target, atom_result, test->result, QUIET_MS))
+			return 0;
+	}
+
+	return 1;
+}
+
+
+static char *write_scripts(void)
+{
+	char template[] = "/tmp/devilspie2-test-XXXXXX";
+	char *folder = mkdtemp(template);
+
+	char path[sizeof(template) + 32];
+	FILE *fp;
+
+	if (!folder)
+		return NULL;
+
+	// long enough for the stimuli to work within
+	snprintf(path, sizeof(path), "%s/devilspie2.lua", folder);
+	fp = fopen(path, "w");
+	if (!fp)
+		return NULL;
+	fprintf(fp, "event_delay = { window_focus = %d, window_blur = %d, window_name_change = %d }\n",
+	        EVENT_DELAY_MS, EVENT_DELAY_MS, EVENT_DELAY_MS);
+	fclose(fp);
+
+	for (int i = 0; i < N_CASES; ++i) {
+		snprintf(path, sizeof(path), "%s/case%d.lua", folder, i);
+		fp = fopen(path, "w");
+		if (!fp)
+			return NULL;
+		// a handler script is set up by the first event for any window,
+		// so it checks for its own window in each function
+		if (cases[i].handler)
+			fprintf(fp, "local mine = \"DP2Test%d\"\n%s\n", i, cases[i].script);
+		else
+			fprintf(fp, "if get_window_class() == \"DP2Test%d\" then\n\t%s\nend\n", i, cases[i].script);
+		fclose(fp);
+	}
+
+	return strdup(folder);
+}
+
+
+static void remove_scripts(const char *folder)
+{
+	char path[256];
+
+	for (int i = 0; i < N_CASES; ++i) {
+		snprintf(path, sizeof(path), "%s/case%d.lua", folder, i);
+		unlink(path);
+	}
+	snprintf(path, sizeof(path), "%s/devilspie2.lua", folder);
+	unlink(path);
+	rmdir(folder);
+}
+
+
+static void usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s -- devilspie2 [args...]\n", prog);
+	exit(2);
+}
+
+
+int main(int argc, char *argv[])
+{
+	int failures = 0;
+	char *folder;
+	char **args;
+	pid_t daemon;
+
+	if (argc < 3 || strcmp(argv[1], "--") != 0)
+		usage(argv[0]);
+
+	dpy = XOpenDisplay(NULL);
+	if (!dpy) {
+		fprintf(stderr, "%s: cannot open display\n", argv[0]);
+		return 1;
+	}
+	root = DefaultRootWindow(dpy);
+	atom_client_list = XInternAtom(dpy, "_NET_CLIENT_LIST", False);
+	atom_client_list_stacking = XInternAtom(dpy, "_NET_CLIENT_LIST_STACKING", False);
+	atom_moveresize = XInternAtom(dpy, "_NET_MOVERESIZE_WINDOW", False);
+	atom_state = XInternAtom(dpy, "_NET_WM_STATE", False);
+	atom_maximized_vert = XInternAtom(dpy, "_NET_WM_STATE_MAXIMIZED_VERT", False);
+	atom_maximized_horz = XInternAtom(dpy, "_NET_WM_STATE_MAXIMIZED_HORZ", False);
+	atom_active_window = XInternAtom(dpy, "_NET_ACTIVE_WINDOW", False);
+	atom_ready = XInternAtom(dpy, "DP2_READY", False);
+	atom_result = XInternAtom(dpy, "DP2_RESULT", False);
+
+	folder = write_scripts();
+	if (!folder) {
+		fprintf(stderr, "%s: couldn't write the test scripts\n", argv[0]);
+		return 1;
+	}
+
+	become_wm();
+
+	// devilspie2 args... --folder <folder>
+	args = calloc(argc + 2, sizeof(char *));
+	for (int i = 2; i < argc; ++i)
+		args[i - 2] = argv[i];
+	args[argc - 2] = "--folder";
+	args[argc - 1] = folder;
+
+	daemon = fork();
+	if (daemon < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (daemon == 0) {
+		execvp(args[0], args);
+		perror(args[0]);
+		_exit(127);
+	}
+
+	for (int i = 0; i < N_CASES; ++i) {
+		// the first case also waits for the daemon to start
+		int ok = run_case(i, i == 0 ? STARTUP_TIMEOUT_MS : TIMEOUT_MS);
+
+		printf("%s: %s\n", ok ? "ok" : "FAIL", cases[i].name);
+		if (!ok && cases[i].result)
+			printf("\tDP2_RESULT: %s\n\texpected:   %s\n",
+			       last_result ? last_result : "(not set)", cases[i].result);
+		if (!ok)
+			++failures;
+	}
+
+	kill(daemon, SIGTERM);
+	waitpid(daemon, NULL, 0);
+
+	remove_scripts(folder);
+	free(folder);
+	free(args);
+	free(last_result);
+	XCloseDisplay(dpy);
+	return failures ? 1 : 0;
+}